@@ -1,165 +1,3386 @@
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/PointerIntPair.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DiagnosticHandler.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/ConstantRange.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DivisionByConstantInfo.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include "llvm/Transforms/Utils/SizeOpts.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Passes/PassBuilder.h"
 
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+
+// InstructionWorklist.h usa LLVM_DEBUG: DEBUG_TYPE deve essere gia' definito
+#define DEBUG_TYPE "testpass"
+#include "llvm/Transforms/Utils/InstructionWorklist.h"
+
 using namespace llvm;
+using namespace llvm::PatternMatch;
+
+namespace {
+
+// I pass riscrivono solo istruzioni, il CFG resta sempre invariato
+static PreservedAnalyses getPreservedAnalyses(bool Changed) {
+    if (!Changed)
+        return PreservedAnalyses::all();
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
+
+static cl::opt<TargetTransformInfo::TargetCostKind> CostKindOverride(
+    "testpass-cost-kind", cl::Hidden,
+    cl::desc("Metrica del modello di costo (default: dagli attributi optsize/minsize)"),
+    cl::values(clEnumValN(TargetTransformInfo::TCK_RecipThroughput, "throughput", "Throughput reciproco"),
+               clEnumValN(TargetTransformInfo::TCK_Latency, "latency", "Latenza"),
+               clEnumValN(TargetTransformInfo::TCK_CodeSize, "code-size", "Dimensione del codice"),
+               clEnumValN(TargetTransformInfo::TCK_SizeAndLatency, "size-latency",
+                          "Dimensione e latenza")));
+
+// Parametri di strength-reduction<...> nella pipeline: famiglie di regole
+// (mul, div, round-down, udiv-cmp, vector; no-<famiglia> le disattiva),
+// max-chain=N e cost=<metrica>, che prevalgono su attributi e opzioni
+struct StrengthReductionOptions {
+    bool Mul = true;
+    bool Div = true;
+    bool RoundDown = true;
+    bool UDivCompare = true;
+    // Anche le istruzioni su vettori
+    bool Vector = true;
+    Optional<unsigned> MaxChain;
+    Optional<TargetTransformInfo::TargetCostKind> CostKind;
+
+    // Per la chiave della cache incrementale
+    uint64_t getCacheKey() const {
+        uint64_t Key = Mul | Div << 1 | RoundDown << 2 | UDivCompare << 3 | Vector << 4;
+        if (CostKind)
+            Key |= uint64_t(*CostKind + 1) << 8;
+        if (MaxChain)
+            Key |= uint64_t(*MaxChain + 1) << 16;
+        return Key;
+    }
+};
+
+// Modello di costo usato per decidere se una mul o una divisione per costante
+// conviene espansa in shift/add/sub. I costi sono nell'unita' di CostKind:
+// cicli per latenza e throughput, istruzioni per la dimensione del codice.
+struct StrengthReductionCostModel {
+    TargetTransformInfo::TargetCostKind CostKind = TargetTransformInfo::TCK_Latency;
+    unsigned MulCost = 3;
+    unsigned DivCost = 26;
+    unsigned ShiftCost = 1;
+    // Shift di un vettore con un amount diverso per lane
+    unsigned VarShiftCost = 1;
+    unsigned AddCost = 1;
+    // Il target ha add/sub con operando shiftato gratis (es. "add x0, x1, x2, lsl #3")
+    bool FoldsShiftIntoAdd = false;
+    // Lunghezza massima della catena emessa
+    unsigned MaxSteps = 6;
+    // Metrica di dimensione scelta perche' il blocco e' freddo secondo il profilo
+    bool ColdCode = false;
+
+    bool optimizesForSize() const {
+        return CostKind == TargetTransformInfo::TCK_CodeSize ||
+               CostKind == TargetTransformInfo::TCK_SizeAndLatency;
+    }
+
+    // Latenze di riferimento per architettura e larghezza, usate dove TTI non
+    // distingue. In LLVM 14 TTI in latenza da' 1 a add/shl/mul e 4 (il costo
+    // generico "costoso") alla div, numeri che non sono cicli. Default x86:
+    // idiv r32 ~26 cicli, r64 ~42
+    static StrengthReductionCostModel forTriple(const Function &F, Type *Ty) {
+        StrengthReductionCostModel CM;
+        bool Wide = Ty->getScalarSizeInBits() > 32;
+        if (Wide)
+            CM.DivCost = 42;
+        Triple T(F.getParent()->getTargetTriple());
+        switch (T.getArch()) {
+        case Triple::aarch64:
+        case Triple::aarch64_be:
+            // sdiv/udiv w ~12 cicli, x ~20 (Cortex-A72, Neoverse)
+            CM.DivCost = Wide ? 20 : 12;
+            CM.FoldsShiftIntoAdd = true;
+            break;
+        case Triple::arm:
+        case Triple::armeb:
+        case Triple::thumb:
+        case Triple::thumbeb:
+            CM.FoldsShiftIntoAdd = true;
+            break;
+        case Triple::riscv32:
+        case Triple::riscv64: {
+            // Senza l'estensione M la mul diventa una chiamata a __mulsi3/__muldi3
+            SmallVector<StringRef, 16> Features;
+            F.getFnAttribute("target-features").getValueAsString().split(Features, ',');
+            if (!is_contained(Features, "+m")) {
+                CM.MulCost = 32;
+                CM.DivCost = 64;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        return CM;
+    }
+
+    // Modello per le operazioni di tipo Ty nella funzione F. La metrica segue
+    // minsize/optsize, e il codice freddo secondo il profilo resta compatto;
+    // i costi di dimensione vengono da TTI, quelli di latenza e throughput
+    // solo se TTI distingue mul da add (per molti target restituisce 1 per
+    // ogni operazione intera), e allora tutti insieme per non mischiare unita
+    static StrengthReductionCostModel forFunction(const Function &F, const TargetTransformInfo &TTI,
+                                                  Type *Ty, bool ColdCode,
+                                                  const StrengthReductionOptions *Options = nullptr) {
+        StrengthReductionCostModel CM = forTriple(F, Ty);
+        if (Options && Options->MaxChain)
+            CM.MaxSteps = *Options->MaxChain;
+        if (Options && Options->CostKind)
+            CM.CostKind = *Options->CostKind;
+        else if (CostKindOverride.getNumOccurrences())
+            CM.CostKind = CostKindOverride;
+        else if (F.hasMinSize())
+            CM.CostKind = TargetTransformInfo::TCK_CodeSize;
+        else if ((CM.ColdCode = ColdCode))
+            CM.CostKind = TargetTransformInfo::TCK_CodeSize;
+        else if (F.hasOptSize())
+            CM.CostKind = TargetTransformInfo::TCK_SizeAndLatency;
+
+        auto costOf = [&](unsigned Opcode, unsigned Default,
+                          TargetTransformInfo::OperandValueKind Op2 = TargetTransformInfo::OK_AnyValue) {
+            InstructionCost C = TTI.getArithmeticInstrCost(Opcode, Ty, CM.CostKind, TargetTransformInfo::OK_AnyValue, Op2);
+            return C.isValid() ? unsigned(*C.getValue()) : Default;
+        };
+        unsigned Mul = costOf(Instruction::Mul, CM.MulCost);
+        unsigned Div = costOf(Instruction::SDiv, CM.DivCost);
+        unsigned Shift = costOf(Instruction::Shl, CM.ShiftCost, TargetTransformInfo::OK_UniformConstantValue);
+        unsigned VarShift = costOf(Instruction::Shl, CM.ShiftCost, TargetTransformInfo::OK_NonUniformConstantValue);
+        unsigned Add = costOf(Instruction::Add, CM.AddCost);
+        CM.VarShiftCost = CM.ShiftCost;
+        if (CM.optimizesForSize() || Mul > Add) {
+            CM.MulCost = Mul;
+            CM.ShiftCost = Shift;
+            CM.VarShiftCost = VarShift;
+            CM.AddCost = Add;
+            CM.DivCost = Div;
+        } else if (Ty->isVectorTy()) {
+            // In latenza TTI di LLVM 14 da' costo 1 a tutto: che gli shift per
+            // lane siano nativi (AVX2, NEON) lo dice solo il throughput. Se uno
+            // shift variabile costa piu' del doppio di uno uniforme (SSE2, o i16
+            // con AVX2) il backend lo espande, spesso proprio in una mul
+            auto shiftThroughput = [&](TargetTransformInfo::OperandValueKind Op2) {
+                return TTI.getArithmeticInstrCost(Instruction::Shl, Ty, TargetTransformInfo::TCK_RecipThroughput,
+                                                  TargetTransformInfo::OK_AnyValue, Op2);
+            };
+            InstructionCost Variable = shiftThroughput(TargetTransformInfo::OK_AnyValue);
+            InstructionCost Uniform = shiftThroughput(TargetTransformInfo::OK_UniformConstantValue);
+            if (!Variable.isValid() || !Uniform.isValid() || Variable > Uniform * 2)
+                CM.VarShiftCost = CM.MulCost;
+        }
+        return CM;
+    }
+};
+
+static cl::opt<bool> ForwardThroughMemorySSA(
+    "testpass-memssa-forwarding", cl::init(true), cl::Hidden,
+    cl::desc("Usa MemorySSA per inoltrare i valori memorizzati ai load anche "
+             "attraverso altri accessi in memoria e tra blocchi diversi"));
+
+// Prodotti parziali x * c gia' emessi dalle espansioni delle mul. Uno shl o
+// una sub che domina il punto di inserimento viene riusato invece di essere
+// ricreato, cosi' x * 15 e x * 16 nello stesso blocco condividono x << 4.
+struct PartialProductCache {
+    // Senza DominatorTree il riuso resta limitato al blocco
+    DominatorTree *DT = nullptr;
+    DenseMap<std::pair<Value *, uint64_t>, WeakVH> Products;
+
+    bool dominates(const Instruction *Def, const Instruction *InsertPt) const {
+        if (Def->getParent() == InsertPt->getParent())
+            return Def->comesBefore(InsertPt);
+        return DT && DT->dominates(Def, InsertPt);
+    }
+
+    // Un valore con flag di overflow che la nuova mul non garantisce li perde
+    Value *lookup(Value *X, const APInt &C, const Instruction *InsertPt, bool NUW, bool NSW) {
+        auto *V = cast_or_null<Instruction>(Products.lookup({X, C.getZExtValue()}));
+        if (!V && C.isPowerOf2())
+            V = findExistingShl(X, C.logBase2(), InsertPt);
+        if (!V || !dominates(V, InsertPt))
+            return nullptr;
+        if (isa<OverflowingBinaryOperator>(V)) {
+            V->setHasNoUnsignedWrap(NUW && V->hasNoUnsignedWrap());
+            V->setHasNoSignedWrap(NSW && V->hasNoSignedWrap());
+        }
+        return V;
+    }
+
+    // Anche gli shl gia' presenti nell'IR contano come prodotti parziali
+    Instruction *findExistingShl(Value *X, unsigned K, const Instruction *InsertPt) const {
+        if (isa<Constant>(X))
+            return nullptr;
+        for (User *U : X->users()) {
+            auto *Shl = dyn_cast<Instruction>(U);
+            if (Shl && Shl != InsertPt && Shl->getFunction() == InsertPt->getFunction() &&
+                match(Shl, m_Shl(m_Specific(X), m_SpecificInt(K))))
+                return Shl;
+        }
+        return nullptr;
+    }
+
+    void insert(Value *X, const APInt &C, Value *V) {
+        if (isa<Instruction>(V))
+            Products[{X, C.getZExtValue()}] = V;
+    }
+};
+
+// Costanti usate dalle espansioni, per tipo e valore. Le sequenze emesse
+// riusano sempre gli stessi shift amount e le stesse maschere: la mappa locale
+// evita a ogni riscrittura la ricerca nelle tabelle di LLVMContext e, per i
+// vettori, la costruzione dello splat. Le voci si creano al primo uso:
+// prepopolare ogni shift amount di ogni larghezza costerebbe piu' delle
+// ricerche risparmiate, dato che quasi tutte le funzioni ne usano pochi.
+class ConstantPool {
+    DenseMap<std::pair<Type *, uint64_t>, Constant *> Small;
+    DenseMap<std::pair<Type *, APInt>, Constant *> Wide;
+    // Vettori non splat, un valore per lane (shift amount e maschere per lane)
+    std::map<std::pair<Type *, SmallVector<uint64_t, 8>>, Constant *> Lanes;
+
+public:
+    // Ty intero o vettore di interi (splat); V viene troncato alla larghezza degli elementi
+    Constant *get(Type *Ty, uint64_t V) {
+        Constant *&C = Small[{Ty, V}];
+        if (!C)
+            C = ConstantInt::get(Ty, V);
+        return C;
+    }
+
+    // V ha la larghezza degli elementi di Ty
+    Constant *get(Type *Ty, const APInt &V) {
+        if (V.getBitWidth() <= 64)
+            return get(Ty, V.getZExtValue());
+        Constant *&C = Wide[{Ty, V}];
+        if (!C)
+            C = ConstantInt::get(Ty, V);
+        return C;
+    }
+
+    // Ty vettore di interi al massimo a 64 bit, con Values.size() lane
+    template <typename T> Constant *getLanes(Type *Ty, ArrayRef<T> Values) {
+        Constant *&C = Lanes[{Ty, SmallVector<uint64_t, 8>(Values.begin(), Values.end())}];
+        if (!C) {
+            SmallVector<Constant *, 16> Elts;
+            for (uint64_t V : Values)
+                Elts.push_back(get(Ty->getScalarType(), V));
+            C = ConstantVector::get(Elts);
+        }
+        return C;
+    }
+};
+
+// Strumentazione delle regole, compilata solo con TESTPASS_ENABLE_PROFILING:
+// per ogni funzione e regola conta le istruzioni esaminate, quelle riscritte e
+// il tempo speso. Con -time-passes ogni regola ha anche un Timer nel gruppo
+// "testpass", con -testpass-profile-file il report viene scritto in JSON.
+#ifdef TESTPASS_PROFILING
+static cl::opt<std::string> ProfileReportFile(
+    "testpass-profile-file", cl::Hidden, cl::value_desc("path"),
+    cl::desc("File JSON con i contatori e i tempi delle regole per funzione"));
+
+struct RuleCounters {
+    uint64_t Inspected = 0;
+    uint64_t Matched = 0;
+    uint64_t Nanos = 0;
+
+    RuleCounters &operator+=(const RuleCounters &Other) {
+        Inspected += Other.Inspected;
+        Matched += Other.Matched;
+        Nanos += Other.Nanos;
+        return *this;
+    }
+};
+
+// Contatori di tutto il processo, scritti all'uscita
+class ProfileReport {
+    std::mutex Lock;
+    std::map<std::string, std::map<std::string, RuleCounters>> Functions;
+
+    void write() {
+        if (ProfileReportFile.empty() || Functions.empty())
+            return;
+        std::error_code EC;
+        raw_fd_ostream OS(ProfileReportFile, EC, sys::fs::OF_Text);
+        if (EC) {
+            errs() << "testpass: cannot write " << ProfileReportFile << ": " << EC.message() << '\n';
+            return;
+        }
+        std::map<std::string, RuleCounters> Totals;
+        auto writeRules = [](json::OStream &J, const std::map<std::string, RuleCounters> &Rules) {
+            J.objectBegin();
+            for (const auto &R : Rules) {
+                J.attributeObject(R.first, [&] {
+                    J.attribute("inspected", int64_t(R.second.Inspected));
+                    J.attribute("matched", int64_t(R.second.Matched));
+                    J.attribute("ns", int64_t(R.second.Nanos));
+                });
+            }
+            J.objectEnd();
+        };
+        json::OStream J(OS, 2);
+        J.objectBegin();
+        J.attributeBegin("functions");
+        J.objectBegin();
+        for (const auto &F : Functions) {
+            J.attributeBegin(F.first);
+            writeRules(J, F.second);
+            J.attributeEnd();
+            for (const auto &R : F.second)
+                Totals[R.first] += R.second;
+        }
+        J.objectEnd();
+        J.attributeEnd();
+        J.attributeBegin("rules");
+        writeRules(J, Totals);
+        J.attributeEnd();
+        J.objectEnd();
+        OS << '\n';
+    }
+
+public:
+    static ProfileReport &get() {
+        static ProfileReport Report;
+        return Report;
+    }
+
+    ~ProfileReport() { write(); }
+
+    void add(StringRef Fn, const DenseMap<const char *, RuleCounters> &Rules) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        auto &Entry = Functions[Fn.str()];
+        for (const auto &R : Rules)
+            Entry[R.first] += R.second;
+    }
+};
+
+// Un Timer per regola, creato al primo uso
+static Timer &getRuleTimer(const char *Name) {
+    static TimerGroup Group("testpass", "TestPass rules");
+    static std::mutex Lock;
+    static DenseMap<const char *, std::unique_ptr<Timer>> Timers;
+    std::lock_guard<std::mutex> Guard(Lock);
+    std::unique_ptr<Timer> &T = Timers[Name];
+    if (!T)
+        T = std::make_unique<Timer>(Name, Name, Group);
+    return *T;
+}
+
+// Contatori dell'invocazione su una funzione, sommati al report alla fine
+class RuleProfiler {
+    const Function &F;
+    DenseMap<const char *, RuleCounters> Rules;
+    // I Timer di -time-passes non sono thread-safe
+    bool Timed;
+
+public:
+    explicit RuleProfiler(const Function &F, bool Timed = true) : F(F), Timed(Timed) {}
+    ~RuleProfiler() {
+        if (!Rules.empty())
+            ProfileReport::get().add(F.getName(), Rules);
+    }
+
+    // Misura un tentativo di applicare la regola Name
+    class Scope {
+        RuleCounters &Counters;
+        std::chrono::steady_clock::time_point Begin;
+        TimeRegion Region;
+
+    public:
+        Scope(RuleProfiler &P, const char *Name)
+            : Counters(P.Rules[Name]), Begin(std::chrono::steady_clock::now()),
+              Region(TimePassesIsEnabled && P.Timed ? &getRuleTimer(Name) : nullptr) {
+            ++Counters.Inspected;
+        }
+        ~Scope() {
+            Counters.Nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - Begin).count();
+        }
+        void matched() { ++Counters.Matched; }
+    };
+};
+#else
+// Senza strumentazione non resta nulla nel codice generato
+struct RuleProfiler {
+    explicit RuleProfiler(const Function &, bool = true) {}
+    struct Scope {
+        Scope(RuleProfiler &, const char *) {}
+        void matched() {}
+    };
+};
+#endif
+
+// Stato condiviso dalle regole durante l'invocazione su una funzione
+struct RewriteContext {
+    Function &F;
+    // Nullo nell'esecuzione parallela: l'analysis manager non e' thread-safe
+    FunctionAnalysisManager *AM;
+
+    // MemorySSA viene richiesta solo al primo load da inoltrare e da quel
+    // momento mantenuta aggiornata tramite MSSAU
+    MemorySSA *MSSA = nullptr;
+    AAResults *AA = nullptr;
+    DominatorTree *DT = nullptr;
+    Optional<MemorySSAUpdater> MSSAU;
+
+    // Un modello di costo per tipo e per codice caldo/freddo, calcolato al primo uso
+    const TargetTransformInfo *TTI = nullptr;
+    SmallDenseMap<PointerIntPair<Type *, 1, bool>, StrengthReductionCostModel, 4> CostModels;
+
+    // Profilo, se presente: PSI deve essere gia' calcolata a livello di modulo
+    ProfileSummaryInfo *PSI = nullptr;
+    BlockFrequencyInfo *BFI = nullptr;
+    bool ProfileQueried = false;
+
+    // Nell'esecuzione parallela serializza le modifiche allo stato condiviso
+    // di LLVMContext: creazione di costanti e tipi, use list delle costanti,
+    // value handle e nomi. I controlli strutturali delle regole leggono solo
+    // l'IR della funzione e restano fuori; lockIR() lo prende prima della
+    // prima modifica e il motore lo rilascia alla fine dell'istruzione
+    std::mutex *IRLock = nullptr;
+    std::unique_lock<std::mutex> IRGuard;
+
+    void lockIR() {
+        if (IRLock && !IRGuard.owns_lock())
+            IRGuard = std::unique_lock<std::mutex>(*IRLock);
+    }
+    void unlockIR() {
+        if (IRGuard.owns_lock())
+            IRGuard.unlock();
+    }
+
+    // Parametri del pass strength-reduction, se e' lui a eseguire le regole
+    const StrengthReductionOptions *Options = nullptr;
+    // La tabella in esecuzione riassocia le costanti (RuleTable::reassociates)
+    bool Reassociates = false;
+    // Alberi di mul gia' raccolti per isInReassociationTree: membro -> radice
+    // e radice -> (esito, membri). Un albero si dimentica appena il motore
+    // crea, riscrive o elimina un suo nodo o un'istruzione adiacente, perche'
+    // solo cosi' cambiano i nodi e le foglie che lo compongono
+    DenseMap<const Instruction *, const Instruction *> ReassociationRoots;
+    DenseMap<const Instruction *, std::pair<bool, SmallVector<const Instruction *, 8>>> ReassociationTrees;
+
+    void forgetReassociationTree(const Value *V) {
+        auto *I = dyn_cast<Instruction>(V);
+        auto It = I ? ReassociationRoots.find(I) : ReassociationRoots.end();
+        if (It == ReassociationRoots.end())
+            return;
+        auto Tree = ReassociationTrees.find(It->second);
+        for (const Instruction *Member : Tree->second.second)
+            ReassociationRoots.erase(Member);
+        ReassociationTrees.erase(Tree);
+    }
+
+    // I, i suoi utenti e i suoi operandi; degli operandi con al massimo due
+    // usi anche gli utenti, che con un uso in piu' o in meno entrano o escono
+    // dal loro albero
+    void forgetReassociationNeighbours(const Instruction &I) {
+        if (ReassociationRoots.empty())
+            return;
+        forgetReassociationTree(&I);
+        for (const User *U : I.users())
+            forgetReassociationTree(U);
+        for (const Value *Op : I.operands()) {
+            forgetReassociationTree(Op);
+            if (isa<Instruction>(Op) && !Op->hasNUsesOrMore(3))
+                for (const User *U : Op->users())
+                    forgetReassociationTree(U);
+        }
+    }
+
+    RuleProfiler Profile;
+
+    RewriteContext(Function &F, FunctionAnalysisManager &AM) : F(F), AM(&AM), Profile(F) {}
+    RewriteContext(Function &F, const TargetTransformInfo &TTI, DominatorTree &DT, ProfileSummaryInfo *PSI,
+                   BlockFrequencyInfo *BFI, std::mutex &IRLock)
+        : F(F), AM(nullptr), DT(&DT), TTI(&TTI), PSI(PSI), BFI(BFI), ProfileQueried(true), IRLock(&IRLock),
+          Profile(F, /*Timed=*/false) {}
+    // La cache dei prodotti tiene dei WeakVH: si distruggono con IRLock preso
+    ~RewriteContext() { lockIR(); }
+
+    bool isColdCode(const BasicBlock *BB) {
+        if (!ProfileQueried) {
+            ProfileQueried = true;
+            PSI = AM->getResult<ModuleAnalysisManagerFunctionProxy>(F)
+                      .getCachedResult<ProfileSummaryAnalysis>(*F.getParent());
+            if (PSI && PSI->hasProfileSummary())
+                BFI = &AM->getResult<BlockFrequencyAnalysis>(F);
+        }
+        return BFI && shouldOptimizeForSize(BB, PSI, BFI);
+    }
+
+    // Modello di costo per riscrivere I, in base al tipo e alla frequenza del blocco
+    const StrengthReductionCostModel &getCostModel(const Instruction &I) {
+        // TTI puo' creare tipi e costanti
+        lockIR();
+        PointerIntPair<Type *, 1, bool> Key(I.getType(), isColdCode(I.getParent()));
+        auto It = CostModels.find(Key);
+        if (It != CostModels.end())
+            return It->second;
+        if (!TTI)
+            TTI = &AM->getResult<TargetIRAnalysis>(F);
+        return CostModels[Key] =
+                   StrengthReductionCostModel::forFunction(F, *TTI, Key.getPointer(), Key.getInt(), Options);
+    }
+
+    // L'esecuzione parallela usa un emitter proprio per la funzione
+    OptimizationRemarkEmitter *ORE = nullptr;
+    Optional<OptimizationRemarkEmitter> OwnedORE;
+
+    OptimizationRemarkEmitter &getORE() {
+        if (!ORE) {
+            if (AM) {
+                ORE = &AM->getResult<OptimizationRemarkEmitterAnalysis>(F);
+            } else {
+                OwnedORE.emplace(&F);
+                ORE = OwnedORE.getPointer();
+            }
+        }
+        return *ORE;
+    }
+
+    // Fatti noti sui valori: known bits e, se gia' calcolata, LazyValueInfo
+    AssumptionCache *AC = nullptr;
+    LazyValueInfo *LVI = nullptr;
+    bool ValueTrackingQueried = false;
+
+    KnownBits computeKnownBits(const Value *V, const Instruction *CxtI) {
+        lockIR();
+        if (!ValueTrackingQueried && AM) {
+            ValueTrackingQueried = true;
+            AC = &AM->getResult<AssumptionAnalysis>(F);
+            if (!DT)
+                DT = &AM->getResult<DominatorTreeAnalysis>(F);
+            LVI = AM->getCachedResult<LazyValueAnalysis>(F);
+        }
+        return llvm::computeKnownBits(V, F.getParent()->getDataLayout(), 0, AC, CxtI, DT);
+    }
+
+    // Il range di LVI tiene conto anche delle condizioni dei branch
+    bool isNonNegative(Value *V, Instruction &CxtI) {
+        return LVI && V->getType()->isIntegerTy() &&
+               LVI->getConstantRange(V, &CxtI, /*UndefAllowed=*/false).isAllNonNegative();
+    }
+
+    // Una sola remark "missed" per istruzione, anche se torna nella worklist,
+    // e nessuna per le istruzioni create dalle regole (es. la mul della mulh)
+    SmallPtrSet<const Instruction *, 8> ReportedMissed;
+    SmallPtrSet<const Instruction *, 16> Created;
+
+    template <typename RemarkFn> void emitMissed(const Instruction &I, RemarkFn Build) {
+        if (Created.count(&I))
+            return;
+        lockIR();
+        OptimizationRemarkEmitter &E = getORE();
+        if (E.allowExtraAnalysis(DEBUG_TYPE) && ReportedMissed.insert(&I).second)
+            E.emit(Build);
+    }
+
+    PartialProductCache Products;
+    ConstantPool Constants;
+
+    PartialProductCache &getPartialProducts() {
+        lockIR();
+        if (!Products.DT) {
+            if (!DT && AM)
+                DT = &AM->getResult<DominatorTreeAnalysis>(F);
+            Products.DT = DT;
+        }
+        return Products;
+    }
+
+    MemorySSA *getMemorySSA() {
+        if (!MSSA && AM && ForwardThroughMemorySSA) {
+            MSSA = &AM->getResult<MemorySSAAnalysis>(F).getMSSA();
+            AA = &AM->getResult<AAManager>(F);
+            DT = &AM->getResult<DominatorTreeAnalysis>(F);
+            MSSAU.emplace(MSSA);
+        }
+        return MSSA;
+    }
+};
+
+// Riassunto degli opcode di una funzione, calcolato una volta e condiviso dai
+// pass finche' l'IR non cambia: una funzione senza opcode di interesse viene
+// scartata senza chiedere nessun'altra analisi, nelle altre si visitano solo
+// i blocchi che contengono un opcode della tabella.
+using OpcodeMask = std::bitset<Instruction::OtherOpsEnd>;
+
+struct OpcodeSummary {
+    OpcodeMask Opcodes;
+    unsigned Counts[Instruction::OtherOpsEnd] = {};
+    // Blocchi non vuoti in ordine, con gli opcode che contengono
+    SmallVector<std::pair<BasicBlock *, OpcodeMask>, 8> Blocks;
+
+    bool hasAnyOf(const OpcodeMask &Mask) const { return (Opcodes & Mask).any(); }
+
+    unsigned count(const OpcodeMask &Mask) const {
+        unsigned N = 0;
+        for (unsigned Opcode = 0; Opcode != Instruction::OtherOpsEnd; ++Opcode)
+            if (Mask.test(Opcode))
+                N += Counts[Opcode];
+        return N;
+    }
+};
+
+struct OpcodeSummaryAnalysis : public AnalysisInfoMixin<OpcodeSummaryAnalysis> {
+    using Result = OpcodeSummary;
+
+    Result run(Function &F, FunctionAnalysisManager &) {
+        OpcodeSummary Summary;
+        for (BasicBlock &BB : F) {
+            OpcodeMask Mask;
+            for (Instruction &I : BB) {
+                Mask.set(I.getOpcode());
+                ++Summary.Counts[I.getOpcode()];
+            }
+            if (Mask.any())
+                Summary.Blocks.push_back({&BB, Mask});
+            Summary.Opcodes |= Mask;
+        }
+        return Summary;
+    }
+
+private:
+    friend AnalysisInfoMixin<OpcodeSummaryAnalysis>;
+    static AnalysisKey Key;
+};
+
+AnalysisKey OpcodeSummaryAnalysis::Key;
+
+// Una regola riceve un'istruzione con l'opcode per cui e' stata registrata e
+// restituisce il valore che la sostituisce (o nullptr se non si applica)
+using RewriteRule = Value *(*)(Instruction &, IRBuilderBase &, RewriteContext &);
+
+// Ogni regola ha il nome usato per le remark e la sua statistica
+struct RuleEntry {
+    RewriteRule Apply;
+    const char *RemarkName;
+    Statistic *Stat;
+};
+
+// Regole indicizzate per opcode: per ogni istruzione si provano solo quelle
+// registrate per il suo opcode, nell'ordine di registrazione
+class RuleTable {
+    SmallVector<RuleEntry, 2> Rules[Instruction::OtherOpsEnd];
+    OpcodeMask Opcodes;
+    bool Reassociates = false;
+
+public:
+    RuleTable &add(std::initializer_list<unsigned> Opcodes, RewriteRule Rule, const char *RemarkName,
+                   Statistic &Stat) {
+        for (unsigned Opcode : Opcodes) {
+            Rules[Opcode].push_back({Rule, RemarkName, &Stat});
+            this->Opcodes.set(Opcode);
+        }
+        return *this;
+    }
+
+    RuleTable &add(const RuleTable &Other) {
+        for (unsigned Opcode = 0; Opcode != Instruction::OtherOpsEnd; ++Opcode)
+            Rules[Opcode].append(Other.Rules[Opcode].begin(), Other.Rules[Opcode].end());
+        Opcodes |= Other.Opcodes;
+        Reassociates |= Other.Reassociates;
+        return *this;
+    }
+
+    // Le regole della tabella riassociano le costanti degli alberi
+    RuleTable &setReassociates() {
+        Reassociates = true;
+        return *this;
+    }
+    bool reassociates() const { return Reassociates; }
+
+    ArrayRef<RuleEntry> lookup(unsigned Opcode) const { return Rules[Opcode]; }
+
+    // Opcode per cui c'e' almeno una regola
+    const OpcodeMask &opcodes() const { return Opcodes; }
+};
+
+// "mul by 15 lowered to shl+sub", "add folded to 0", ...
+static void emitAppliedRemark(RewriteContext &Ctx, const RuleEntry &Rule, Instruction &I, Value *V,
+                              ArrayRef<Instruction *> Created) {
+    Ctx.getORE().emit([&]() {
+        OptimizationRemark R(DEBUG_TYPE, Rule.RemarkName, &I);
+        R << ore::NV("Opcode", I.getOpcodeName());
+        for (Value *Op : I.operands()) {
+            if (isa<Constant>(Op)) {
+                R << " by " << ore::NV("Constant", Op);
+                break;
+            }
+        }
+        if (V == &I) {
+            R << " rewritten in place";
+        } else if (!Created.empty()) {
+            std::string Sequence;
+            for (Instruction *New : Created)
+                Sequence += (Sequence.empty() ? "" : "+") + std::string(New->getOpcodeName());
+            R << " lowered to " << ore::NV("Sequence", Sequence);
+        } else if (isa<Constant>(V)) {
+            R << " folded to " << ore::NV("Result", V);
+        } else {
+            R << " replaced by existing " << ore::NV("Result", V);
+        }
+        return R;
+    });
+}
+
+// Verifica delle riscritture, per il fuzzing e prima di abilitare regole
+// nuove: con -testpass-verify-rewrites ogni sostituzione intera scalare viene
+// valutata su casi limite e input casuali prima di essere applicata, e
+// scartata se su qualche input l'originale e' definito e la sostituta no o
+// vale altro. Con -testpass-alive2-dir le coppie originale/sostituta vengono
+// scritte come funzioni @src/@tgt da controllare con alive-tv.
+static cl::opt<bool> VerifyRewrites(
+    "testpass-verify-rewrites", cl::Hidden,
+    cl::desc("Valuta ogni riscrittura su input di prova e scarta quelle che cambiano il risultato"));
+
+static cl::opt<unsigned> VerifySamples("testpass-verify-samples", cl::init(256), cl::Hidden,
+                                       cl::desc("Input di prova per ogni riscrittura verificata"));
+
+static cl::opt<std::string> Alive2Dir(
+    "testpass-alive2-dir", cl::Hidden, cl::value_desc("dir"),
+    cl::desc("Directory in cui scrivere le riscritture come coppie @src/@tgt per alive-tv"));
+
+STATISTIC(NumRewritesRejected, "riscritture scartate dalla verifica");
+
+static Value *findForwardedStore(LoadInst *L, RewriteContext &Ctx);
+
+// Oltre questa profondita' le istruzioni diventano input liberi
+static constexpr unsigned MaxVerifyDepth = 24;
+
+// Espressione intera scalare sotto le radici aggiunte: le istruzioni che la
+// verifica sa valutare, in ordine topologico, e le foglie (argomenti, load,
+// phi, chiamate, ...) che diventano input liberi. Le radici condividono
+// nodi e foglie, quindi originale e sostituta vedono gli stessi input. Un
+// load a cui le regole inoltrano un valore memorizzato vale quel valore.
+struct RewriteExpr {
+    SmallVector<Instruction *, 16> Nodes;
+    SmallVector<Value *, 8> Leaves;
+    DenseMap<Value *, Value *> Forwarded;
+    bool Valid = true;
+
+    explicit RewriteExpr(function_ref<Value *(LoadInst *)> Forward) : Forward(Forward) {}
+
+    void add(Value *V, unsigned Depth = 0) {
+        if (!Visited.insert(V).second || isa<ConstantInt>(V))
+            return;
+        if (!V->getType()->isIntegerTy() || isa<Constant>(V)) {
+            Valid = false;
+            return;
+        }
+        auto *I = dyn_cast<Instruction>(V);
+        if (auto *L = dyn_cast_or_null<LoadInst>(I)) {
+            Value *Stored = Depth != MaxVerifyDepth ? Forward(L) : nullptr;
+            if (Stored && Stored->getType() == L->getType()) {
+                Forwarded[L] = Stored;
+                add(Stored, Depth + 1);
+                Nodes.push_back(L);
+                return;
+            }
+        }
+        if (!I || Depth == MaxVerifyDepth || !isEvaluable(*I)) {
+            Leaves.push_back(V);
+            return;
+        }
+        for (Value *Op : I->operands())
+            add(Op, Depth + 1);
+        Nodes.push_back(I);
+    }
+
+    // Nodi da cui dipende Root, nell'ordine di Nodes
+    SmallVector<Instruction *, 16> getCone(Value *Root) const {
+        SmallPtrSet<Value *, 16> InCone;
+        SmallVector<Value *, 16> Stack{Root};
+        while (!Stack.empty()) {
+            auto *I = dyn_cast<Instruction>(Stack.pop_back_val());
+            if (!I || is_contained(Leaves, I) || !InCone.insert(I).second)
+                continue;
+            if (Value *Stored = Forwarded.lookup(I))
+                Stack.push_back(Stored);
+            else
+                append_range(Stack, I->operands());
+        }
+        SmallVector<Instruction *, 16> Cone;
+        for (Instruction *N : Nodes)
+            if (InCone.count(N))
+                Cone.push_back(N);
+        return Cone;
+    }
+
+private:
+    function_ref<Value *(LoadInst *)> Forward;
+    SmallPtrSet<Value *, 32> Visited;
+
+    static bool isEvaluable(const Instruction &I) {
+        switch (I.getOpcode()) {
+        case Instruction::Add:
+        case Instruction::Sub:
+        case Instruction::Mul:
+        case Instruction::UDiv:
+        case Instruction::SDiv:
+        case Instruction::URem:
+        case Instruction::SRem:
+        case Instruction::Shl:
+        case Instruction::LShr:
+        case Instruction::AShr:
+        case Instruction::And:
+        case Instruction::Or:
+        case Instruction::Xor:
+        case Instruction::ZExt:
+        case Instruction::SExt:
+        case Instruction::Trunc:
+            return true;
+        case Instruction::ICmp:
+            return I.getOperand(0)->getType()->isIntegerTy();
+        case Instruction::Select:
+            return I.getOperand(0)->getType()->isIntegerTy(1);
+        default:
+            return false;
+        }
+    }
+};
+
+// Valore di un'istruzione su un input: definito, poison, oppure UB (divisione
+// per zero, anche in un operando)
+struct EvalState {
+    enum Kind { Defined, Poison, UB } K = Defined;
+    APInt V;
+};
+
+static EvalState evaluateInstruction(const Instruction &I, ArrayRef<const EvalState *> Ops) {
+    auto poison = [] { return EvalState{EvalState::Poison, APInt()}; };
+    for (const EvalState *Op : Ops)
+        if (Op->K == EvalState::UB)
+            return *Op;
+    if (isa<SelectInst>(&I)) {
+        if (Ops[0]->K == EvalState::Poison)
+            return poison();
+        return *Ops[Ops[0]->V.getBoolValue() ? 1 : 2];
+    }
+    // Divisioni: un divisore poison o nullo e' UB anche se il dividendo e' poison
+    switch (I.getOpcode()) {
+    case Instruction::UDiv:
+    case Instruction::URem:
+    case Instruction::SDiv:
+    case Instruction::SRem: {
+        if (Ops[1]->K == EvalState::Poison || Ops[1]->V.isZero())
+            return EvalState{EvalState::UB, APInt()};
+        bool Signed = I.getOpcode() == Instruction::SDiv || I.getOpcode() == Instruction::SRem;
+        if (Signed && Ops[0]->K == EvalState::Defined && Ops[0]->V.isMinSignedValue() && Ops[1]->V.isAllOnes())
+            return EvalState{EvalState::UB, APInt()};
+        break;
+    }
+    default:
+        break;
+    }
+    for (const EvalState *Op : Ops)
+        if (Op->K == EvalState::Poison)
+            return poison();
+
+    const APInt &A = Ops[0]->V;
+    unsigned BW = I.getType()->getIntegerBitWidth();
+    bool NUW = isa<OverflowingBinaryOperator>(I) && I.hasNoUnsignedWrap();
+    bool NSW = isa<OverflowingBinaryOperator>(I) && I.hasNoSignedWrap();
+    bool Exact = isa<PossiblyExactOperator>(I) && I.isExact();
+    bool UOv = false, SOv = false;
+    APInt R;
+    switch (I.getOpcode()) {
+    case Instruction::ZExt:
+        return {EvalState::Defined, A.zext(BW)};
+    case Instruction::SExt:
+        return {EvalState::Defined, A.sext(BW)};
+    case Instruction::Trunc:
+        return {EvalState::Defined, A.trunc(BW)};
+    case Instruction::ICmp:
+        return {EvalState::Defined, APInt(1, ICmpInst::compare(A, Ops[1]->V, cast<ICmpInst>(I).getPredicate()))};
+    default:
+        break;
+    }
+    const APInt &B = Ops[1]->V;
+    switch (I.getOpcode()) {
+    case Instruction::Add:
+        R = A.uadd_ov(B, UOv);
+        (void)A.sadd_ov(B, SOv);
+        break;
+    case Instruction::Sub:
+        R = A.usub_ov(B, UOv);
+        (void)A.ssub_ov(B, SOv);
+        break;
+    case Instruction::Mul:
+        R = A.umul_ov(B, UOv);
+        (void)A.smul_ov(B, SOv);
+        break;
+    case Instruction::UDiv:
+        R = A.udiv(B);
+        Exact &= !A.urem(B).isZero();
+        return Exact ? poison() : EvalState{EvalState::Defined, R};
+    case Instruction::SDiv:
+        R = A.sdiv(B);
+        Exact &= !A.srem(B).isZero();
+        return Exact ? poison() : EvalState{EvalState::Defined, R};
+    case Instruction::URem:
+        return {EvalState::Defined, A.urem(B)};
+    case Instruction::SRem:
+        return {EvalState::Defined, A.srem(B)};
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr: {
+        if (B.uge(BW))
+            return poison();
+        unsigned S = B.getZExtValue();
+        if (I.getOpcode() == Instruction::Shl) {
+            R = A.shl(S);
+            UOv = R.lshr(S) != A;
+            SOv = R.ashr(S) != A;
+        } else {
+            R = I.getOpcode() == Instruction::LShr ? A.lshr(S) : A.ashr(S);
+            if (Exact && A.countTrailingZeros() < S)
+                return poison();
+        }
+        break;
+    }
+    case Instruction::And:
+        return {EvalState::Defined, A & B};
+    case Instruction::Or:
+        return {EvalState::Defined, A | B};
+    case Instruction::Xor:
+        return {EvalState::Defined, A ^ B};
+    default:
+        llvm_unreachable("opcode non valutabile");
+    }
+    if ((NUW && UOv) || (NSW && SOv))
+        return poison();
+    return {EvalState::Defined, R};
+}
+
+// Input di prova: prima combinazioni di casi limite, poi valori casuali,
+// piccoli o su tutta la larghezza
+static APInt getVerifyInput(unsigned BW, unsigned Sample, unsigned Leaf, std::mt19937_64 &RNG) {
+    const APInt Special[] = {APInt(BW, 0), APInt(BW, 1), APInt::getAllOnes(BW), APInt::getSignedMinValue(BW),
+                             APInt::getSignedMaxValue(BW), APInt(BW, 2), APInt(BW, -2, true),
+                             APInt::getSignedMinValue(BW) + 1, APInt(BW, 7), APInt(BW, -8, true)};
+    constexpr unsigned NumSpecial = array_lengthof(Special);
+    if (Sample < NumSpecial * NumSpecial) {
+        unsigned Idx = Leaf == 0 ? Sample % NumSpecial : (Sample / NumSpecial + Leaf - 1) % NumSpecial;
+        return Special[Idx];
+    }
+    uint64_t Words[2] = {RNG(), RNG()};
+    APInt V(BW, BW > 64 ? 2 : 1, Words);
+    if (Sample % 2)
+        V = APInt(BW, Words[0] % 256 - 128, true);
+    return V;
+}
+
+// Cerca un input su cui sostituire Old con New cambia il risultato; Expr
+// contiene entrambi. Le foglie rispettano i known bits e il range di LVI
+// in Old, gli stessi fatti su cui si basano le regole. Counterexample
+// descrive l'input trovato
+static bool verifyReplacement(const RewriteExpr &Expr, Instruction &Old, Value *New, RewriteContext &Ctx,
+                              std::string &Counterexample) {
+    // Un'istruzione che la verifica non sa valutare sarebbe un input libero
+    if (!Expr.Valid || !is_contained(Expr.Nodes, &Old))
+        return true;
+
+    SmallVector<KnownBits, 8> LeafKnown;
+    SmallVector<ConstantRange, 8> LeafRange;
+    for (Value *Leaf : Expr.Leaves) {
+        LeafKnown.push_back(Ctx.computeKnownBits(Leaf, &Old));
+        LeafRange.push_back(Ctx.LVI ? Ctx.LVI->getConstantRange(Leaf, &Old, /*UndefAllowed=*/false)
+                                    : ConstantRange::getFull(Leaf->getType()->getIntegerBitWidth()));
+    }
+    // Porta l'input dentro i fatti noti; false se non ci riesce
+    auto constrain = [&](unsigned L, APInt &V) {
+        const KnownBits &Known = LeafKnown[L];
+        const ConstantRange &Range = LeafRange[L];
+        if (Known.hasConflict() || Range.isEmptySet())
+            return false;
+        V = (V & ~Known.Zero) | Known.One;
+        if (!Range.contains(V) && !Range.isWrappedSet())
+            V = (Range.getLower() + V.urem(Range.getUpper() - Range.getLower()));
+        V = (V & ~Known.Zero) | Known.One;
+        return Range.contains(V);
+    };
+
+    // Tutte le voci vengono create prima: i puntatori in Ops restano validi
+    DenseMap<const Value *, EvalState> States;
+    for (Value *Leaf : Expr.Leaves)
+        States[Leaf];
+    for (Instruction *N : Expr.Nodes) {
+        States[N];
+        for (Value *Op : N->operands())
+            if (auto *C = dyn_cast<ConstantInt>(Op))
+                States[C].V = C->getValue();
+    }
+    for (const auto &Entry : Expr.Forwarded)
+        if (auto *C = dyn_cast<ConstantInt>(Entry.second))
+            States[C].V = C->getValue();
+    if (auto *C = dyn_cast<ConstantInt>(New))
+        States[C].V = C->getValue();
+    auto stateOf = [&](const Value *V) -> const EvalState & { return States.find(V)->second; };
+
+    std::mt19937_64 RNG(0x7e57);
+    SmallVector<const EvalState *, 3> Ops;
+    for (unsigned Sample = 0; Sample != VerifySamples; ++Sample) {
+        bool Feasible = true;
+        for (unsigned L = 0; L != Expr.Leaves.size() && Feasible; ++L) {
+            Value *Leaf = Expr.Leaves[L];
+            APInt V = getVerifyInput(Leaf->getType()->getIntegerBitWidth(), Sample, L, RNG);
+            Feasible = constrain(L, V);
+            States[Leaf] = {EvalState::Defined, V};
+        }
+        if (!Feasible)
+            continue;
+        for (Instruction *N : Expr.Nodes) {
+            if (Value *Stored = Expr.Forwarded.lookup(N)) {
+                States.find(N)->second = stateOf(Stored);
+                continue;
+            }
+            Ops.clear();
+            for (Value *Op : N->operands())
+                Ops.push_back(&stateOf(Op));
+            States.find(N)->second = evaluateInstruction(*N, Ops);
+        }
+        const EvalState &Src = stateOf(&Old);
+        const EvalState &Tgt = stateOf(New);
+        if (Src.K != EvalState::Defined || (Tgt.K == EvalState::Defined && Tgt.V == Src.V))
+            continue;
+
+        raw_string_ostream OS(Counterexample);
+        for (Value *Leaf : Expr.Leaves) {
+            OS << (Leaf == Expr.Leaves.front() ? "" : ", ");
+            Leaf->printAsOperand(OS, false);
+            OS << " = " << stateOf(Leaf).V;
+        }
+        OS << ": expected " << Src.V << ", got ";
+        if (Tgt.K == EvalState::Defined)
+            OS << Tgt.V;
+        else
+            OS << (Tgt.K == EvalState::Poison ? "poison" : "undefined behavior");
+        return false;
+    }
+    return true;
+}
+
+// Scrive in Alive2Dir la funzione @src con l'espressione originale e @tgt con
+// la sostituta, con le foglie come argomenti
+static void dumpAlive2Pair(const RewriteExpr &Expr, Instruction &Old, Value *New, const char *RuleName) {
+    static std::atomic<unsigned> Counter(0);
+    if (!Expr.Valid || !is_contained(Expr.Nodes, &Old))
+        return;
+
+    Function &F = *Old.getFunction();
+    Module M("alive2", F.getContext());
+    M.setDataLayout(F.getParent()->getDataLayout());
+    SmallVector<Type *, 8> Params;
+    for (Value *Leaf : Expr.Leaves)
+        Params.push_back(Leaf->getType());
+    FunctionType *FT = FunctionType::get(Old.getType(), Params, false);
+    for (std::pair<const char *, Value *> Side : {std::make_pair("src", (Value *)&Old), std::make_pair("tgt", New)}) {
+        Function *Fn = Function::Create(FT, GlobalValue::ExternalLinkage, Side.first, M);
+        BasicBlock *BB = BasicBlock::Create(F.getContext(), "entry", Fn);
+        ValueToValueMapTy VMap;
+        for (unsigned L = 0; L != Expr.Leaves.size(); ++L)
+            VMap[Expr.Leaves[L]] = Fn->getArg(L);
+        for (Instruction *N : Expr.getCone(Side.second)) {
+            if (Value *Stored = Expr.Forwarded.lookup(N)) {
+                Value *Mapped = VMap.lookup(Stored);
+                VMap[N] = Mapped ? Mapped : Stored;
+                continue;
+            }
+            Instruction *C = N->clone();
+            C->setName(N->getName());
+            C->setDebugLoc(DebugLoc());
+            BB->getInstList().push_back(C);
+            VMap[N] = C;
+            RemapInstruction(C, VMap, RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+        }
+        Value *Ret = VMap.lookup(Side.second);
+        ReturnInst::Create(F.getContext(), Ret ? Ret : Side.second, BB);
+    }
+
+    SmallString<128> Path(Alive2Dir);
+    sys::path::append(Path, (F.getName() + "-" + RuleName + "-" + Twine(Counter++) + ".ll").str());
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+    if (!EC)
+        M.print(OS, nullptr);
+}
+
+// Applica la verifica e il dump per Alive2 alla sostituzione di Old con New,
+// sull'IR prima del replaceAllUsesWith; false se la verifica la scarta
+static bool checkRewrite(Instruction &Old, Value *New, const RuleEntry &Rule, RewriteContext &Ctx) {
+    auto Forward = [&](LoadInst *L) { return findForwardedStore(L, Ctx); };
+    RewriteExpr Expr(Forward);
+    Expr.add(&Old);
+    Expr.add(New);
+    if (!Alive2Dir.empty())
+        dumpAlive2Pair(Expr, Old, New, Rule.RemarkName);
+    std::string Counterexample;
+    if (!VerifyRewrites || verifyReplacement(Expr, Old, New, Ctx, Counterexample))
+        return true;
+    ++NumRewritesRejected;
+    errs() << "testpass: " << Rule.RemarkName << " rewrite of '" << Old << "' in @" << Old.getFunction()->getName()
+           << " rejected: " << Counterexample << '\n';
+    return false;
+}
+
+// Motore a worklist condiviso dai pass: quando un'istruzione viene sostituita
+// i suoi utenti tornano nella worklist, cosi' le semplificazioni esposte da
+// una riscrittura vengono trovate nella stessa invocazione del pass.
+// Le sostituzioni si raccolgono e si applicano tutte insieme, con una sola
+// passata di eliminazione delle istruzioni morte, quando la worklist passa a
+// un altro blocco o arriva a un utente di un'istruzione in attesa di
+// sostituzione: cosi' le regole vedono sempre i valori nuovi, e le
+// riscritture indipendenti di un blocco finiscono nello stesso lotto.
+// Summary, se l'IR non e' cambiato da quando e' stato calcolato, limita la
+// visita iniziale ai blocchi con opcode di interesse
+static bool runToFixpoint(Function &F, const RuleTable &Rules, RewriteContext &Ctx,
+                          const OpcodeSummary *Summary = nullptr) {
+#ifdef TESTPASS_PROFILING
+    TimeTraceScope TraceScope("TestPassRules", F.getName());
+#endif
+    Ctx.Reassociates = Rules.reassociates();
+    InstructionWorklist Worklist;
+    // Istruzioni create dalla regola in corso, per la remark
+    SmallVector<Instruction *, 8> Created;
+    IRBuilder<ConstantFolder, IRBuilderCallbackInserter> Builder(
+        F.getContext(), ConstantFolder(), IRBuilderCallbackInserter([&](Instruction *I) {
+            Worklist.push(I);
+            Created.push_back(I);
+            Ctx.Created.insert(I);
+            Ctx.forgetReassociationNeighbours(*I);
+        }));
+
+    // Inserite al contrario, cosi' vengono estratte nell'ordine del programma
+    SmallVector<Instruction *, 256> Seed;
+    auto seedBlock = [&](BasicBlock &BB) {
+        for (auto &I : BB)
+            if (!Rules.lookup(I.getOpcode()).empty())
+                Seed.push_back(&I);
+    };
+    if (Summary) {
+        Seed.reserve(Summary->count(Rules.opcodes()));
+        for (const auto &Entry : Summary->Blocks)
+            if ((Entry.second & Rules.opcodes()).any())
+                seedBlock(*Entry.first);
+    } else {
+        for (auto &BB : F)
+            seedBlock(BB);
+    }
+    Worklist.reserve(Seed.size());
+    for (Instruction *I : reverse(Seed))
+        Worklist.push(I);
+
+    // Le istruzioni rimaste senza utenti vengono eliminate insieme agli
+    // operandi che diventano a loro volta morti
+    auto forgetDead = [&](Instruction *Dead) {
+        Worklist.remove(Dead);
+        Ctx.forgetReassociationNeighbours(*Dead);
+        for (Value *Op : Dead->operands())
+            if (auto *OpI = dyn_cast<Instruction>(Op))
+                if (OpI != Dead)
+                    Worklist.push(OpI);
+    };
+    auto eraseIfDead = [&](Instruction *I) {
+        RecursivelyDeleteTriviallyDeadInstructions(I, nullptr, Ctx.MSSAU ? Ctx.MSSAU.getPointer() : nullptr,
+                                                   [&](Value *V) { forgetDead(cast<Instruction>(V)); });
+    };
+
+    // Sostituzioni del blocco corrente, in ordine di match
+    SmallVector<std::pair<Instruction *, Value *>, 16> Pending;
+    BasicBlock *PendingBlock = nullptr;
+    // Utenti delle istruzioni in Pending
+    SmallPtrSet<const Instruction *, 16> PendingUsers;
+    SmallVector<WeakTrackingVH, 16> Dead;
+    // Un sostituto a sua volta sostituito nello stesso blocco (la mul creata
+    // dalla riassociazione e poi espansa) si risolve nel valore finale; le
+    // istruzioni sostituite restano senza utenti e si eliminano in una volta.
+    // Prende IRLock, che rilascia chi la chiama
+    SmallDenseMap<Value *, Value *, 16> Replacements;
+    auto applyPending = [&]() {
+        Ctx.lockIR();
+        for (auto &P : Pending)
+            if (P.second != P.first)
+                Replacements[P.first] = P.second;
+        for (auto &P : Pending) {
+            Instruction *I = P.first;
+            Worklist.pushUsersToWorkList(*I);
+            Ctx.forgetReassociationNeighbours(*I);
+            if (P.second == I) {
+                // Riscritta sul posto
+                Worklist.push(I);
+                continue;
+            }
+            Value *V = P.second;
+            for (auto It = Replacements.find(V); It != Replacements.end(); It = Replacements.find(V))
+                V = It->second;
+            if (auto *New = dyn_cast<Instruction>(V))
+                Ctx.forgetReassociationNeighbours(*New);
+            I->replaceAllUsesWith(V);
+            Worklist.pushValue(V);
+        }
+        Replacements.clear();
+        for (auto &P : Pending) {
+            Instruction *I = P.first;
+            if (P.second == I)
+                continue;
+            if (isInstructionTriviallyDead(I))
+                Dead.push_back(I);
+            else
+                Worklist.push(I);
+        }
+        Pending.clear();
+        PendingUsers.clear();
+        RecursivelyDeleteTriviallyDeadInstructions(Dead, nullptr, Ctx.MSSAU ? Ctx.MSSAU.getPointer() : nullptr,
+                                                   [&](Value *V) { forgetDead(cast<Instruction>(V)); });
+        Dead.clear();
+    };
+
+    bool Changed = false;
+    while (true) {
+        if (Worklist.isEmpty()) {
+            if (Pending.empty())
+                break;
+            applyPending();
+            Ctx.unlockIR();
+            continue;
+        }
+        Instruction *I = Worklist.removeOne();
+        if (!I)
+            continue;
+        if (!Pending.empty() && (I->getParent() != PendingBlock || PendingUsers.count(I))) {
+            // L'applicazione puo' eliminare I: torna nella worklist, che la segue
+            Worklist.push(I);
+            applyPending();
+            Ctx.unlockIR();
+            continue;
+        }
+        if (Ctx.Options && !Ctx.Options->Vector && I->getType()->isVectorTy())
+            continue;
+
+        // Le regole prendono IRLock solo se devono modificare qualcosa; da una
+        // riscrittura trovata in poi lo si tiene fino alla prossima istruzione
+        auto Unlock = make_scope_exit([&] { Ctx.unlockIR(); });
+        // Sui vettori anche i matcher degli splat creano costanti
+        if (I->getType()->isVectorTy())
+            Ctx.lockIR();
+        Builder.SetInsertPoint(I);
+        Created.clear();
+        Value *V = nullptr;
+        const RuleEntry *Applied = nullptr;
+        for (const RuleEntry &Rule : Rules.lookup(I->getOpcode())) {
+            RuleProfiler::Scope Profile(Ctx.Profile, Rule.RemarkName);
+            if ((V = Rule.Apply(*I, Builder, Ctx))) {
+                Profile.matched();
+                Applied = &Rule;
+                break;
+            }
+        }
+        if (!V)
+            continue;
+        Ctx.lockIR();
+        // Una sostituzione scartata lascia senza utenti le istruzioni create;
+        // WeakVH perche' eliminarne una puo' eliminare i suoi operandi. Prima
+        // si applicano quelle in sospeso, i cui sostituti non hanno ancora
+        // utenti e verrebbero eliminati con lei
+        if (V != I && (VerifyRewrites || !Alive2Dir.empty()) && !checkRewrite(*I, V, *Applied, Ctx)) {
+            SmallVector<WeakVH, 8> Discarded(Created.rbegin(), Created.rend());
+            if (!Pending.empty())
+                applyPending();
+            for (WeakVH &VH : Discarded)
+                if (auto *New = cast_or_null<Instruction>(VH))
+                    eraseIfDead(New);
+            continue;
+        }
+        Changed = true;
+        ++*Applied->Stat;
+        emitAppliedRemark(Ctx, *Applied, *I, V, Created);
+        Pending.push_back({I, V});
+        PendingBlock = I->getParent();
+        if (V != I)
+            for (const User *U : I->users())
+                PendingUsers.insert(cast<Instruction>(U));
+    }
+    Worklist.zap();
+    return Changed;
+}
+
+// Modalita' incrementale: con -testpass-cache-file ogni pass ricorda gli hash
+// delle funzioni in cui non ha trovato nulla da riscrivere e, alla run
+// successiva, le salta senza chiedere nessuna analisi. Una collisione o una
+// voce vecchia possono solo far perdere una riscrittura, mai cambiare il
+// risultato del programma.
+static cl::opt<std::string> RewriteCacheFile(
+    "testpass-cache-file", cl::Hidden, cl::value_desc("path"),
+    cl::desc("File in cui ricordare le funzioni che i pass hanno lasciato invariate"));
+
+// Da incrementare quando cambiano le regole, per invalidare le cache esistenti
+static constexpr unsigned RewriteCacheVersion = 2;
+
+// Hash stabile tra esecuzioni diverse: a differenza di StructuralHash di LLVM
+// tiene conto delle costanti, dei flag e di come le istruzioni si usano a
+// vicenda, cioe' di tutto quello che guardano le regole. I valori locali sono
+// numerati in ordine, quindi i nomi non contano.
+// Metadati che cambiano i fatti visti dalle regole: pesi dei branch, known
+// bits e range, alias analysis dell'inoltro degli store
+static constexpr unsigned SemanticMetadataKinds[] = {
+    LLVMContext::MD_prof,  LLVMContext::MD_range, LLVMContext::MD_nonnull,     LLVMContext::MD_noundef,
+    LLVMContext::MD_align, LLVMContext::MD_tbaa,  LLVMContext::MD_tbaa_struct, LLVMContext::MD_alias_scope,
+    LLVMContext::MD_noalias, LLVMContext::MD_invariant_load};
+
+class FunctionHasher {
+    SmallVector<uint64_t, 256> Tokens;
+    DenseMap<const Value *, uint64_t> Numbers;
+    DenseMap<const MDNode *, uint64_t> Nodes;
+
+    void add(uint64_t V) { Tokens.push_back(V); }
+    void add(StringRef S) { add(xxHash64(S)); }
+
+    void addAPInt(const APInt &V) {
+        add(V.getBitWidth());
+        for (unsigned I = 0; I != V.getNumWords(); ++I)
+            add(V.getRawData()[I]);
+    }
+
+    void addType(Type *Ty) {
+        add(Ty->getTypeID());
+        if (auto *IT = dyn_cast<IntegerType>(Ty)) {
+            add(IT->getBitWidth());
+        } else if (auto *VT = dyn_cast<VectorType>(Ty)) {
+            add(VT->getElementCount().getKnownMinValue());
+            addType(VT->getElementType());
+        } else if (auto *AT = dyn_cast<ArrayType>(Ty)) {
+            add(AT->getNumElements());
+            addType(AT->getElementType());
+        } else if (auto *ST = dyn_cast<StructType>(Ty)) {
+            // Le struct con nome possono essere ricorsive
+            if (ST->hasName()) {
+                add(ST->getName());
+            } else {
+                for (Type *E : ST->elements())
+                    addType(E);
+            }
+        } else if (auto *PT = dyn_cast<PointerType>(Ty)) {
+            add(PT->getAddressSpace());
+        } else if (auto *FT = dyn_cast<FunctionType>(Ty)) {
+            add(FT->isVarArg());
+            addType(FT->getReturnType());
+            for (Type *P : FT->params())
+                addType(P);
+        }
+    }
+
+    void addConstant(const Constant *C) {
+        add(C->getValueID());
+        addType(C->getType());
+        if (auto *CI = dyn_cast<ConstantInt>(C)) {
+            addAPInt(CI->getValue());
+        } else if (auto *CFP = dyn_cast<ConstantFP>(C)) {
+            addAPInt(CFP->getValueAPF().bitcastToAPInt());
+        } else if (auto *GV = dyn_cast<GlobalValue>(C)) {
+            add(GV->getName());
+        } else if (auto *CDS = dyn_cast<ConstantDataSequential>(C)) {
+            add(CDS->getRawDataValues());
+        } else if (!isa<BlockAddress>(C)) {
+            if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+                add(CE->getOpcode());
+                add(CE->getRawSubclassOptionalData());
+                if (CE->isCompare())
+                    add(CE->getPredicate());
+            }
+            for (const Value *Op : C->operands())
+                addConstant(cast<Constant>(Op));
+        }
+    }
+
+    void addValue(const Value *V) {
+        if (auto *C = dyn_cast<Constant>(V))
+            return addConstant(C);
+        add(V->getValueID());
+        auto It = Numbers.find(V);
+        if (It != Numbers.end())
+            add(It->second);
+        else if (auto *IA = dyn_cast<InlineAsm>(V))
+            add(IA->getAsmString());
+    }
+
+    // I nodi sono numerati alla prima visita: gli scope di alias.scope sono ciclici
+    void addMetadata(const Metadata *MD) {
+        if (!MD)
+            return add(0);
+        add(MD->getMetadataID());
+        if (auto *S = dyn_cast<MDString>(MD))
+            return add(S->getString());
+        if (auto *CM = dyn_cast<ConstantAsMetadata>(MD))
+            return addConstant(CM->getValue());
+        auto *N = dyn_cast<MDNode>(MD);
+        if (!N)
+            return;
+        auto Inserted = Nodes.try_emplace(N, Nodes.size());
+        if (!Inserted.second)
+            return add(Inserted.first->second);
+        add(N->isDistinct());
+        add(N->getNumOperands());
+        for (const MDOperand &Op : N->operands())
+            addMetadata(Op.get());
+    }
+
+    // Attributi della funzione, del valore di ritorno e di ogni parametro
+    void addAttributes(AttributeList Attrs) {
+        add(Attrs.getNumAttrSets());
+        for (unsigned Index : Attrs.indexes())
+            add(Attrs.getAsString(Index));
+    }
+
+    void addInstruction(const Instruction &I) {
+        add(I.getOpcode());
+        addType(I.getType());
+        add(I.getRawSubclassOptionalData());
+        add(I.getNumOperands());
+        for (const Value *Op : I.operands())
+            addValue(Op);
+        if (auto *Cmp = dyn_cast<CmpInst>(&I)) {
+            add(Cmp->getPredicate());
+        } else if (auto *LI = dyn_cast<LoadInst>(&I)) {
+            add(LI->isVolatile());
+            add(LI->getAlign().value());
+            add(static_cast<unsigned>(LI->getOrdering()));
+        } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+            add(SI->isVolatile());
+            add(SI->getAlign().value());
+            add(static_cast<unsigned>(SI->getOrdering()));
+        } else if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+            addType(AI->getAllocatedType());
+            add(AI->getAlign().value());
+        } else if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
+            addType(GEP->getSourceElementType());
+        } else if (auto *PN = dyn_cast<PHINode>(&I)) {
+            for (const BasicBlock *BB : PN->blocks())
+                addValue(BB);
+        } else if (auto *SV = dyn_cast<ShuffleVectorInst>(&I)) {
+            for (int M : SV->getShuffleMask())
+                add(static_cast<uint64_t>(M));
+        } else if (auto *EV = dyn_cast<ExtractValueInst>(&I)) {
+            for (unsigned Idx : EV->getIndices())
+                add(Idx);
+        } else if (auto *IV = dyn_cast<InsertValueInst>(&I)) {
+            for (unsigned Idx : IV->getIndices())
+                add(Idx);
+        }
+        if (auto *CB = dyn_cast<CallBase>(&I)) {
+            addType(CB->getFunctionType());
+            addAttributes(CB->getAttributes());
+        }
+        if (I.hasMetadataOtherThanDebugLoc()) {
+            for (unsigned Kind : SemanticMetadataKinds) {
+                if (const MDNode *MD = I.getMetadata(Kind)) {
+                    add(Kind);
+                    addMetadata(MD);
+                }
+            }
+        }
+    }
+
+public:
+    // Extra distingue le configurazioni che cambiano cosa riscrivono le regole
+    uint64_t hash(const Function &F, StringRef PassName, ArrayRef<uint64_t> Extra) {
+        add(RewriteCacheVersion);
+        add(PassName);
+        for (uint64_t E : Extra)
+            add(E);
+        const Module &M = *F.getParent();
+        add(M.getTargetTriple());
+        add(M.getDataLayoutStr());
+        addAttributes(F.getAttributes());
+        if (Optional<Function::ProfileCount> Count = F.getEntryCount())
+            add(Count->getCount());
+        addType(F.getFunctionType());
+
+        uint64_t N = 0;
+        for (const Argument &A : F.args())
+            Numbers[&A] = N++;
+        for (const BasicBlock &BB : F) {
+            Numbers[&BB] = N++;
+            for (const Instruction &I : BB)
+                Numbers[&I] = N++;
+        }
+        for (const BasicBlock &BB : F) {
+            add(BB.size());
+            for (const Instruction &I : BB)
+                addInstruction(I);
+        }
+        return xxHash64(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(Tokens.data()),
+                                          Tokens.size() * sizeof(uint64_t)));
+    }
+};
+
+// Insieme degli hash "nessuna modifica", letto alla prima richiesta e riscritto
+// all'uscita. Il file viene riletto prima di salvare, cosi' le compilazioni
+// che lo condividono in parallelo sommano le voci invece di perderle, e
+// sostituito con un rename per non lasciarlo mai a meta'.
+class RewriteCache {
+    std::mutex Lock;
+    DenseSet<uint64_t> Unchanged;
+    DenseSet<uint64_t> Recorded;
+    bool Loaded = false;
+
+    static constexpr const char *Header = "testpass-cache";
+
+    static void read(StringRef Path, DenseSet<uint64_t> &Into) {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> Buf = MemoryBuffer::getFile(Path, /*IsText=*/true);
+        if (!Buf)
+            return;
+        SmallVector<StringRef, 0> Lines;
+        (*Buf)->getBuffer().split(Lines, '\n', -1, /*KeepEmpty=*/false);
+        // Un file di un'altra versione viene ignorato
+        if (Lines.empty() || Lines[0].trim() != (Twine(Header) + " " + Twine(RewriteCacheVersion)).str())
+            return;
+        for (StringRef Line : drop_begin(Lines)) {
+            uint64_t H;
+            if (!Line.trim().getAsInteger(16, H))
+                Into.insert(H);
+        }
+    }
+
+    void save() {
+        if (Recorded.empty())
+            return;
+        StringRef Path = RewriteCacheFile;
+        DenseSet<uint64_t> All;
+        read(Path, All);
+        All.insert(Recorded.begin(), Recorded.end());
+
+        int FD;
+        SmallString<128> TmpPath;
+        if (sys::fs::createUniqueFile(Path + ".tmp-%%%%%%", FD, TmpPath))
+            return;
+        {
+            raw_fd_ostream OS(FD, /*shouldClose=*/true);
+            OS << Header << ' ' << RewriteCacheVersion << '\n';
+            for (uint64_t H : All)
+                OS << format_hex_no_prefix(H, 16) << '\n';
+            if (OS.has_error()) {
+                OS.clear_error();
+                sys::fs::remove(TmpPath);
+                return;
+            }
+        }
+        if (sys::fs::rename(TmpPath, Path))
+            sys::fs::remove(TmpPath);
+    }
+
+public:
+    static RewriteCache &get() {
+        static RewriteCache Cache;
+        return Cache;
+    }
+
+    ~RewriteCache() { save(); }
+
+    bool isUnchanged(uint64_t Hash) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        if (!Loaded) {
+            Loaded = true;
+            read(RewriteCacheFile, Unchanged);
+        }
+        return Unchanged.count(Hash);
+    }
 
-namespace {
+    void recordUnchanged(uint64_t Hash) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        if (Unchanged.insert(Hash).second)
+            Recorded.insert(Hash);
+    }
+};
+
+// Hash della funzione per la cache, None se la cache non va usata: con le
+// remark attive una funzione saltata perderebbe le sue "missed", con la
+// verifica o il dump per Alive2 le sue riscritture non verrebbero controllate
+static Optional<uint64_t> getRewriteCacheKey(const Function &F, StringRef PassName, ArrayRef<uint64_t> Extra) {
+    if (RewriteCacheFile.empty() || VerifyRewrites || !Alive2Dir.empty())
+        return None;
+    const LLVMContext &C = F.getContext();
+    if (C.getLLVMRemarkStreamer() || C.getDiagHandlerPtr()->isAnyRemarkEnabled(DEBUG_TYPE))
+        return None;
+    return FunctionHasher().hash(F, PassName, Extra);
+}
+
+// Opzioni, parametri del pass e analisi che cambiano l'esito delle regole a
+// parita' di IR
+static SmallVector<uint64_t, 5> getRewriteCacheConfig(bool HasProfile, bool HasLVI,
+                                                      const StrengthReductionOptions *Options = nullptr) {
+    return {CostKindOverride.getNumOccurrences() ? uint64_t(CostKindOverride) + 1 : 0,
+            ForwardThroughMemorySSA, HasProfile, HasLVI, Options ? Options->getCacheKey() + 1 : 0};
+}
+
+static PreservedAnalyses runRules(Function &F, FunctionAnalysisManager &AM, StringRef PassName,
+                                  const RuleTable &Rules, const StrengthReductionOptions *Options = nullptr) {
+    const OpcodeSummary &Summary = AM.getResult<OpcodeSummaryAnalysis>(F);
+    if (!Summary.hasAnyOf(Rules.opcodes()))
+        return PreservedAnalyses::all();
+
+    Optional<uint64_t> CacheKey;
+    if (!RewriteCacheFile.empty()) {
+        const auto *PSI = AM.getResult<ModuleAnalysisManagerFunctionProxy>(F)
+                              .getCachedResult<ProfileSummaryAnalysis>(*F.getParent());
+        CacheKey = getRewriteCacheKey(
+            F, PassName,
+            getRewriteCacheConfig(PSI && PSI->hasProfileSummary(), AM.getCachedResult<LazyValueAnalysis>(F),
+                                  Options));
+        if (CacheKey && RewriteCache::get().isUnchanged(*CacheKey))
+            return PreservedAnalyses::all();
+    }
+
+    RewriteContext Ctx(F, AM);
+    Ctx.Options = Options;
+    bool Changed = runToFixpoint(F, Rules, Ctx, &Summary);
+    if (CacheKey && !Changed)
+        RewriteCache::get().recordUnchanged(*CacheKey);
+    PreservedAnalyses PA = getPreservedAnalyses(Changed);
+    if (Ctx.MSSA)
+        PA.preserve<MemorySSAAnalysis>();
+    return PA;
+}
+
+// Riassociazione: catene di add/mul/and/or/xor con un solo uso vengono
+// appiattite, le costanti raccolte in una sola e spostata sull'operando 1.
+// Cosi' ((x * 3) * 5) diventa x * 15 e ((x + 4) + 7) - 11 diventa x.
+
+// Numero massimo di foglie di un albero, per limitare il costo su catene lunghe
+static constexpr unsigned MaxReassociationLeaves = 16;
+
+// Opcode dell'albero a cui appartiene I; sub x, C conta come add x, -C
+static unsigned getReassociationOpcode(const Instruction &I) {
+    if (!I.getType()->isIntOrIntVectorTy())
+        return 0;
+    switch (I.getOpcode()) {
+    case Instruction::Sub:
+        return match(I.getOperand(1), m_ImmConstant()) ? Instruction::Add : 0;
+    case Instruction::Add:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+        return I.getOpcode();
+    default:
+        return 0;
+    }
+}
+
+struct ReassociationTree {
+    unsigned Opcode;
+    const DataLayout &DL;
+    SmallVector<Value *, 8> Leaves;
+    // Nodi interni, radice compresa
+    SmallVector<Instruction *, 8> Nodes;
+    // Le costanti raccolte, con quelle delle sub da negare; le combina
+    // foldConstants(), che crea nuove costanti nel contesto
+    SmallVector<std::pair<Constant *, bool>, 4> Constants;
+    Constant *C = nullptr;
+    // I flag si conservano solo se li hanno tutti i nodi e le costanti si
+    // combinano senza overflow
+    bool NUW = true;
+    bool NSW = true;
+
+    ReassociationTree(unsigned Opcode, const DataLayout &DL) : Opcode(Opcode), DL(DL) {}
+
+    void addConstant(Constant *K) {
+        if (!C) {
+            C = K;
+            return;
+        }
+        const APInt *A, *B;
+        if (match(C, m_APInt(A)) && match(K, m_APInt(B))) {
+            bool UOv = false, SOv = false;
+            if (Opcode == Instruction::Add) {
+                (void)A->uadd_ov(*B, UOv);
+                (void)A->sadd_ov(*B, SOv);
+            } else if (Opcode == Instruction::Mul) {
+                (void)A->umul_ov(*B, UOv);
+                (void)A->smul_ov(*B, SOv);
+            }
+            NUW &= !UOv;
+            NSW &= !SOv;
+        } else {
+            NUW = NSW = false;
+        }
+        C = ConstantFoldBinaryOpOperands(Opcode, C, K, DL);
+    }
+
+    void foldConstants() {
+        for (const auto &K : Constants)
+            addConstant(K.second ? ConstantExpr::getNeg(K.first) : K.first);
+    }
+
+    // I nodi interni stanno nel blocco della radice: l'albero viene ricostruito
+    // li', e altrimenti si sposterebbero calcoli dentro un loop
+    void collect(Value *V, const Instruction &Root) {
+        auto *I = dyn_cast<Instruction>(V);
+        if (I && getReassociationOpcode(*I) == Opcode &&
+            (I == &Root || (I->hasOneUse() && I->getParent() == Root.getParent())) &&
+            Leaves.size() < MaxReassociationLeaves) {
+            if (isa<OverflowingBinaryOperator>(I)) {
+                NUW &= I->hasNoUnsignedWrap();
+                NSW &= I->hasNoSignedWrap();
+            }
+            Nodes.push_back(I);
+            if (I->getOpcode() == Instruction::Sub) {
+                NUW = NSW = false;
+                collect(I->getOperand(0), Root);
+                Constants.push_back({cast<Constant>(I->getOperand(1)), true});
+                return;
+            }
+            collect(I->getOperand(0), Root);
+            collect(I->getOperand(1), Root);
+            return;
+        }
+        if (match(V, m_ImmConstant()))
+            Constants.push_back({cast<Constant>(V), false});
+        else
+            Leaves.push_back(V);
+    }
+};
+
+// I e' la radice del suo albero se il suo unico utente non lo assorbe
+static bool isReassociationRoot(const Instruction &I, unsigned Opcode) {
+    if (!I.hasOneUse())
+        return true;
+    auto *User = dyn_cast<Instruction>(I.user_back());
+    return !User || User->getParent() != I.getParent() || getReassociationOpcode(*User) != Opcode;
+}
+
+// Foglie della mul V nell'albero con i nodi interni nel blocco BB, fino a Limit
+static unsigned countMulLeaves(const Value *V, const BasicBlock *BB, unsigned Limit) {
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || getReassociationOpcode(*I) != Instruction::Mul || !I->hasOneUse() || I->getParent() != BB)
+        return match(V, m_ImmConstant()) ? 0 : 1;
+    unsigned Leaves = 0;
+    for (const Value *Op : I->operands())
+        if (Leaves < Limit)
+            Leaves += countMulLeaves(Op, BB, Limit - Leaves);
+    return Leaves;
+}
+
+// Una mul non radice fa parte dell'albero della sua radice, a meno che il
+// limite di foglie non la lasci fuori. Risalendo si contano le foglie dei
+// rami laterali: se arrivano al limite l'albero e' fuori senza raccoglierlo.
+// Altrimenti l'albero si raccoglie una volta sola dalla radice e l'esito vale
+// per tutti i suoi nodi, che la worklist visita prima della radice
+static bool isInReassociationTree(Instruction &I, RewriteContext &Ctx) {
+    if (isReassociationRoot(I, Instruction::Mul))
+        return false;
+    auto It = Ctx.ReassociationRoots.find(&I);
+    if (It != Ctx.ReassociationRoots.end())
+        return Ctx.ReassociationTrees.find(It->second)->second.first;
+
+    SmallVector<const Instruction *, 16> Path{&I};
+    unsigned SideLeaves = 0;
+    Instruction *Root = &I;
+    while (!isReassociationRoot(*Root, Instruction::Mul)) {
+        auto *User = cast<Instruction>(Root->user_back());
+        for (const Value *Op : User->operands())
+            if (Op != Root && SideLeaves < MaxReassociationLeaves)
+                SideLeaves += countMulLeaves(Op, User->getParent(), MaxReassociationLeaves - SideLeaves);
+        if (SideLeaves >= MaxReassociationLeaves)
+            return false;
+        Root = User;
+        Path.push_back(Root);
+    }
+
+    ReassociationTree Tree(Instruction::Mul, I.getModule()->getDataLayout());
+    Tree.collect(Root, *Root);
+    bool InTree = Tree.Leaves.size() < MaxReassociationLeaves;
+    auto &Entry = Ctx.ReassociationTrees[Root];
+    Entry.first = InTree;
+    Path.append(Tree.Nodes.begin(), Tree.Nodes.end());
+    for (const Instruction *Member : Path)
+        if (Ctx.ReassociationRoots.insert({Member, Root}).second)
+            Entry.second.push_back(Member);
+    return InTree;
+}
+
+// op C, x -> op x, C per le operazioni commutative
+static Value *canonicalizeConstantOperand(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    if (!I.isCommutative() || !isa<Constant>(I.getOperand(0)) || isa<Constant>(I.getOperand(1)))
+        return nullptr;
+    // Lo scambio tocca la use list della costante
+    Ctx.lockIR();
+    cast<BinaryOperator>(I).swapOperands();
+    return &I;
+}
+
+static Value *reassociateConstants(Instruction &I, IRBuilderBase &B, RewriteContext &Ctx) {
+    unsigned Opcode = getReassociationOpcode(I);
+    if (!Opcode || !isReassociationRoot(I, Opcode))
+        return nullptr;
+    ReassociationTree Tree(Opcode, I.getModule()->getDataLayout());
+    Tree.collect(&I, I);
+    if (Tree.Constants.empty())
+        return nullptr;
+    // Solo costanti, ad esempio dopo che un operando e' stato sostituito da una costante
+    if (Tree.Leaves.empty()) {
+        Ctx.lockIR();
+        Tree.foldConstants();
+        return Tree.C;
+    }
+    // Gia' canonico: un'unica costante, operando 1 della radice (anche di una sub)
+    if (Tree.Constants.size() == 1 &&
+        (I.getOpcode() == Instruction::Sub || I.getOperand(1) == Tree.Constants.front().first))
+        return nullptr;
+    Ctx.lockIR();
+    Tree.foldConstants();
+
+    bool Add = Opcode == Instruction::Add;
+    bool Mul = Opcode == Instruction::Mul;
+    // Con piu' foglie l'ordine delle operazioni cambia: resta solo nuw delle add
+    bool NUW = (Add || Mul) && Tree.NUW && (Tree.Leaves.size() == 1 || Add);
+    bool NSW = (Add || Mul) && Tree.NSW && Tree.Leaves.size() == 1;
+
+    if (Tree.C == ConstantExpr::getBinOpAbsorber(Opcode, I.getType()))
+        return Tree.C;
+    auto createOp = [&](Value *LHS, Value *RHS) {
+        Value *V = B.CreateBinOp(Instruction::BinaryOps(Opcode), LHS, RHS, Instruction::getOpcodeName(Opcode));
+        if (auto *BO = dyn_cast<BinaryOperator>(V)) {
+            if (NUW)
+                BO->setHasNoUnsignedWrap();
+            if (NSW)
+                BO->setHasNoSignedWrap();
+        }
+        return V;
+    };
+    Value *V = Tree.Leaves.front();
+    for (Value *Leaf : makeArrayRef(Tree.Leaves).drop_front())
+        V = createOp(V, Leaf);
+    if (Tree.C == ConstantExpr::getBinOpIdentity(Opcode, I.getType()))
+        return V;
+    return createOp(V, Tree.C);
+}
+
+STATISTIC(NumConstantOperandSwapped, "costanti spostate sull'operando 1");
+STATISTIC(NumReassociated, "alberi di operazioni associative riscritti con una sola costante");
+
+static const RuleTable &getReassociationRules() {
+    static const RuleTable Rules = RuleTable()
+        .add({Instruction::Add, Instruction::Mul, Instruction::And, Instruction::Or, Instruction::Xor},
+             canonicalizeConstantOperand, "ConstantOperandSwapped", NumConstantOperandSwapped)
+        .add({Instruction::Add, Instruction::Sub, Instruction::Mul, Instruction::And, Instruction::Or,
+              Instruction::Xor},
+             reassociateConstants, "Reassociated", NumReassociated)
+        .setReassociates();
+    return Rules;
+}
+
+struct ConstantReassociationPass : public PassInfoMixin<ConstantReassociationPass> {
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        return runRules(F, AM, name(), getReassociationRules());
+    }
+};
 
 // Primo Pass: Algebraic Identity
+// Elementi neutri e assorbenti. I matcher di PatternMatch riconoscono anche
+// le costanti splat dei vettori (con eventuali lane undef).
+// Lo zero e il -1 del tipo di I si creano nel contesto condiviso
+static Constant *getNullValue(const Instruction &I, RewriteContext &Ctx) {
+    Ctx.lockIR();
+    return Constant::getNullValue(I.getType());
+}
+
+static Constant *getAllOnesValue(const Instruction &I, RewriteContext &Ctx) {
+    Ctx.lockIR();
+    return Constant::getAllOnesValue(I.getType());
+}
+
+static Value *foldAddIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    Value *X;
+    if (match(&I, m_c_Add(m_Value(X), m_Zero())))
+        return X;
+    return nullptr;
+}
+
+static Value *foldSubIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_Sub(m_Value(X), m_Zero())))
+        return X;
+    if (I.getOperand(0) == I.getOperand(1))
+        return getNullValue(I, Ctx);
+    return nullptr;
+}
+
+static Value *foldMulIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_c_Mul(m_Value(X), m_One())))
+        return X;
+    if (match(&I, m_c_Mul(m_Value(), m_Zero())))
+        return getNullValue(I, Ctx);
+    return nullptr;
+}
+
+static Value *foldAndIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_c_And(m_Value(X), m_AllOnes())))
+        return X;
+    if (match(&I, m_c_And(m_Value(), m_Zero())))
+        return getNullValue(I, Ctx);
+    if (I.getOperand(0) == I.getOperand(1))
+        return I.getOperand(0);
+    return nullptr;
+}
+
+static Value *foldOrIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_c_Or(m_Value(X), m_Zero())))
+        return X;
+    if (match(&I, m_c_Or(m_Value(), m_AllOnes())))
+        return getAllOnesValue(I, Ctx);
+    if (I.getOperand(0) == I.getOperand(1))
+        return I.getOperand(0);
+    return nullptr;
+}
+
+static Value *foldXorIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_c_Xor(m_Value(X), m_Zero())))
+        return X;
+    if (I.getOperand(0) == I.getOperand(1))
+        return getNullValue(I, Ctx);
+    return nullptr;
+}
+
+// shl/lshr/ashr x, 0
+static Value *foldShiftIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    if (match(I.getOperand(1), m_Zero()))
+        return I.getOperand(0);
+    return nullptr;
+}
+
+// udiv/sdiv x, 1
+static Value *foldDivIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    if (match(I.getOperand(1), m_One()))
+        return I.getOperand(0);
+    return nullptr;
+}
+
+// x + -0.0 == x sempre, x + 0.0 solo se il segno dello zero non conta
+static Value *foldFAddIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    Value *X;
+    if (match(&I, m_c_FAdd(m_Value(X), m_NegZeroFP())))
+        return X;
+    if (I.hasNoSignedZeros() && match(&I, m_c_FAdd(m_Value(X), m_PosZeroFP())))
+        return X;
+    return nullptr;
+}
+
+static Value *foldFSubIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    Value *X;
+    if (match(&I, m_FSub(m_Value(X), m_PosZeroFP())))
+        return X;
+    if (I.hasNoSignedZeros() && match(&I, m_FSub(m_Value(X), m_NegZeroFP())))
+        return X;
+    return nullptr;
+}
+
+static Value *foldFMulIdentity(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *X;
+    if (match(&I, m_c_FMul(m_Value(X), m_FPOne())))
+        return X;
+    // x * 0.0 == 0.0 solo senza NaN/infiniti e ignorando il segno dello zero
+    if (I.hasNoNaNs() && I.hasNoInfs() && I.hasNoSignedZeros() && match(&I, m_c_FMul(m_Value(), m_AnyZeroFP())))
+        return getNullValue(I, Ctx);
+    return nullptr;
+}
+
+static Value *foldFDivIdentity(Instruction &I, IRBuilderBase &, RewriteContext &) {
+    if (match(I.getOperand(1), m_FPOne()))
+        return I.getOperand(0);
+    return nullptr;
+}
+
+STATISTIC(NumAddIdentity, "x + 0 semplificate");
+STATISTIC(NumSubIdentity, "x - 0 e x - x semplificate");
+STATISTIC(NumMulIdentity, "mul per 1 e per 0 semplificate");
+STATISTIC(NumAndIdentity, "and con -1, 0 o se stesso semplificate");
+STATISTIC(NumOrIdentity, "or con 0, -1 o se stesso semplificate");
+STATISTIC(NumXorIdentity, "xor con 0 o se stesso semplificate");
+STATISTIC(NumShiftIdentity, "shift di 0 semplificati");
+STATISTIC(NumDivIdentity, "divisioni per 1 semplificate");
+STATISTIC(NumFAddIdentity, "fadd con -0.0/+0.0 semplificate");
+STATISTIC(NumFSubIdentity, "fsub con +0.0/-0.0 semplificate");
+STATISTIC(NumFMulIdentity, "fmul per 1.0 e 0.0 semplificate");
+STATISTIC(NumFDivIdentity, "fdiv per 1.0 semplificate");
+
+static const RuleTable &getAlgebraicIdentityRules() {
+    static const RuleTable Rules = RuleTable()
+        .add({Instruction::Add}, foldAddIdentity, "AddIdentity", NumAddIdentity)
+        .add({Instruction::Sub}, foldSubIdentity, "SubIdentity", NumSubIdentity)
+        .add({Instruction::Mul}, foldMulIdentity, "MulIdentity", NumMulIdentity)
+        .add({Instruction::And}, foldAndIdentity, "AndIdentity", NumAndIdentity)
+        .add({Instruction::Or}, foldOrIdentity, "OrIdentity", NumOrIdentity)
+        .add({Instruction::Xor}, foldXorIdentity, "XorIdentity", NumXorIdentity)
+        .add({Instruction::Shl, Instruction::LShr, Instruction::AShr}, foldShiftIdentity, "ShiftIdentity",
+             NumShiftIdentity)
+        .add({Instruction::UDiv, Instruction::SDiv}, foldDivIdentity, "DivIdentity", NumDivIdentity)
+        .add({Instruction::FAdd}, foldFAddIdentity, "FAddIdentity", NumFAddIdentity)
+        .add({Instruction::FSub}, foldFSubIdentity, "FSubIdentity", NumFSubIdentity)
+        .add({Instruction::FMul}, foldFMulIdentity, "FMulIdentity", NumFMulIdentity)
+        .add({Instruction::FDiv}, foldFDivIdentity, "FDivIdentity", NumFDivIdentity);
+    return Rules;
+}
+
 struct AlgebraicIdentityPass : public PassInfoMixin<AlgebraicIdentityPass> {
-    PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
-        for (auto &BB : F) {
-            for (auto it = BB.begin(), end = BB.end(); it != end;) {
-                Instruction *I = &*it++;
-                if (auto *binOp = dyn_cast<BinaryOperator>(I)) {
-                    if (binOp->getOpcode() == Instruction::Add) {
-                        if (auto *C = dyn_cast<ConstantInt>(binOp->getOperand(1))) {
-                            if (C->isZero()) {
-                                binOp->replaceAllUsesWith(binOp->getOperand(0));
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                        if (auto *C = dyn_cast<ConstantInt>(binOp->getOperand(0))) {
-                            if (C->isZero()) {
-                                binOp->replaceAllUsesWith(binOp->getOperand(1));
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                    }
-                    if (binOp->getOpcode() == Instruction::Mul) {
-                        if (auto *C = dyn_cast<ConstantInt>(binOp->getOperand(1))) {
-                            if (C->isOne()) {
-                                binOp->replaceAllUsesWith(binOp->getOperand(0));
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                        if (auto *C = dyn_cast<ConstantInt>(binOp->getOperand(0))) {
-                            if (C->isOne()) {
-                                binOp->replaceAllUsesWith(binOp->getOperand(1));
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                    }
-                }
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        return runRules(F, AM, name(), getAlgebraicIdentityRules());
+    }
+};
+
+// Un passo di una catena shift/add/sub. Il valore 0 e' il moltiplicando x,
+// il passo i-esimo produce il valore i + 1.
+struct MulChainStep {
+    enum Kind : uint8_t { Shl, Add, Sub, Neg };
+    Kind Op;
+    uint8_t LHS;
+    uint8_t RHS; // per Shl e' lo shift amount, per Neg e' ignorato
+};
+
+struct MulChain {
+    SmallVector<MulChainStep, 8> Steps;
+    unsigned Latency = 0;
+    unsigned Size = 0;
+    unsigned NumOps = 0;
+
+    unsigned last() const { return Steps.size(); }
+
+    bool isAddOnly() const {
+        return all_of(Steps, [](const MulChainStep &S) { return S.Op == MulChainStep::Shl || S.Op == MulChainStep::Add; });
+    }
+
+    unsigned add(MulChainStep::Kind Op, unsigned LHS, unsigned RHS) {
+        Steps.push_back({Op, uint8_t(LHS), uint8_t(RHS)});
+        return last();
+    }
+
+    // Calcola cammino critico, costo totale e numero di istruzioni effettivamente emesse
+    void computeCost(const StrengthReductionCostModel &CM) {
+        SmallVector<unsigned, 8> Depth{0};
+        SmallVector<unsigned, 8> Uses(Steps.size() + 1, 0);
+        for (const MulChainStep &S : Steps) {
+            ++Uses[S.LHS];
+            if (S.Op == MulChainStep::Add || S.Op == MulChainStep::Sub)
+                ++Uses[S.RHS];
+        }
+        auto isFoldedShift = [&](unsigned V) {
+            return CM.FoldsShiftIntoAdd && V > 0 && Steps[V - 1].Op == MulChainStep::Shl &&
+                   Uses[V] == 1 && V != last();
+        };
+        Latency = 0;
+        Size = 0;
+        NumOps = 0;
+        for (unsigned i = 0, e = Steps.size(); i != e; ++i) {
+            const MulChainStep &S = Steps[i];
+            unsigned Cost;
+            unsigned D;
+            if (S.Op == MulChainStep::Shl) {
+                Cost = isFoldedShift(i + 1) ? 0 : CM.ShiftCost;
+                D = Depth[S.LHS] + Cost;
+            } else if (S.Op == MulChainStep::Neg) {
+                Cost = CM.AddCost;
+                D = Depth[S.LHS] + Cost;
+            } else {
+                Cost = CM.AddCost;
+                D = std::max(Depth[S.LHS], Depth[S.RHS]) + Cost;
+            }
+            if (Cost || S.Op != MulChainStep::Shl)
+                ++NumOps;
+            Size += Cost;
+            Depth.push_back(D);
+        }
+        Latency = Depth.back();
+    }
+
+    // Ottimizzando per dimensione conta il costo totale, altrimenti il cammino critico
+    unsigned getPrimaryCost(const StrengthReductionCostModel &CM) const {
+        return CM.optimizesForSize() ? Size : Latency;
+    }
+
+    bool isBetterThan(const MulChain &Other, const StrengthReductionCostModel &CM) const {
+        unsigned Primary = getPrimaryCost(CM);
+        unsigned OtherPrimary = Other.getPrimaryCost(CM);
+        if (Primary != OtherPrimary)
+            return Primary < OtherPrimary;
+        return NumOps < Other.NumOps;
+    }
+
+    // Per la dimensione basta non crescere (uno shl al posto di una mul non
+    // allunga il codice), per latenza e throughput serve un guadagno stretto
+    bool isProfitable(const StrengthReductionCostModel &CM) const {
+        if (Steps.empty() || Steps.size() > CM.MaxSteps)
+            return false;
+        if (CM.optimizesForSize())
+            return Size <= CM.MulCost;
+        return Latency < CM.MulCost;
+    }
+};
+
+// Catena ricavata dalla forma non adiacente (NAF) di C: somma di termini
+// +-(x << k), ricombinati ad albero per ridurre il cammino critico. Con
+// AddOnly usa la scrittura binaria, solo termini positivi.
+static MulChain buildNAFChain(const APInt &C, const StrengthReductionCostModel &CM, bool AddOnly = false) {
+    unsigned BW = C.getBitWidth();
+    struct Term {
+        unsigned Val;
+        bool Negated;
+    };
+    SmallVector<Term, 8> Terms;
+    MulChain Chain;
+
+    APInt V = C.sext(BW + 2);
+    for (unsigned Pos = 0; !V.isZero() && Pos < BW; ++Pos) {
+        if (V[0]) {
+            bool Negated = !AddOnly && V[1];
+            unsigned Val = Pos ? Chain.add(MulChainStep::Shl, 0, Pos) : 0;
+            Terms.push_back({Val, Negated});
+            if (Negated)
+                ++V;
+            else
+                --V;
+        }
+        V.ashrInPlace(1);
+    }
+
+    while (Terms.size() > 1) {
+        SmallVector<Term, 8> Next;
+        for (unsigned i = 0; i + 1 < Terms.size(); i += 2) {
+            Term A = Terms[i], B = Terms[i + 1];
+            if (A.Negated == B.Negated)
+                Next.push_back({Chain.add(MulChainStep::Add, A.Val, B.Val), A.Negated});
+            else if (B.Negated)
+                Next.push_back({Chain.add(MulChainStep::Sub, A.Val, B.Val), false});
+            else
+                Next.push_back({Chain.add(MulChainStep::Sub, B.Val, A.Val), false});
+        }
+        if (Terms.size() % 2)
+            Next.push_back(Terms.back());
+        Terms = std::move(Next);
+    }
+    if (!Terms.empty() && Terms[0].Negated)
+        Chain.add(MulChainStep::Neg, Terms[0].Val, 0);
+    Chain.computeCost(CM);
+    return Chain;
+}
+
+// Cerca la catena piu' economica per una costante positiva: oltre alla NAF
+// prova a fattorizzare C = C' * 2^s e C = C' * (2^k +- 1). Con AddOnly
+// solo shl e add, cosi' i flag della mul restano validi su ogni passo.
+static MulChain findPositiveMulChain(uint64_t C, unsigned BW, const StrengthReductionCostModel &CM,
+                                     DenseMap<uint64_t, MulChain> &Memo, bool AddOnly = false) {
+    auto It = Memo.find(C);
+    if (It != Memo.end())
+        return It->second;
+
+    MulChain Best = buildNAFChain(APInt(BW, C), CM, AddOnly);
+    auto consider = [&](MulChain Candidate) {
+        Candidate.computeCost(CM);
+        if (Candidate.isBetterThan(Best, CM))
+            Best = std::move(Candidate);
+    };
+
+    unsigned TZ = countTrailingZeros(C);
+    if (TZ && C != (uint64_t(1) << TZ)) {
+        MulChain Sub = findPositiveMulChain(C >> TZ, BW, CM, Memo, AddOnly);
+        Sub.add(MulChainStep::Shl, Sub.last(), TZ);
+        consider(std::move(Sub));
+    } else if (C & 1) {
+        for (unsigned k = 1; k < BW && k < 63; ++k) {
+            uint64_t Pow = uint64_t(1) << k;
+            if (Pow > C)
+                break;
+            for (bool Plus : {true, false}) {
+                uint64_t F = Plus ? Pow + 1 : Pow - 1;
+                if ((AddOnly && !Plus) || F <= 1 || F >= C || C % F)
+                    continue;
+                MulChain Sub = findPositiveMulChain(C / F, BW, CM, Memo, AddOnly);
+                unsigned R = Sub.last();
+                unsigned S = Sub.add(MulChainStep::Shl, R, k);
+                Sub.add(Plus ? MulChainStep::Add : MulChainStep::Sub, S, R);
+                consider(std::move(Sub));
             }
         }
-        return PreservedAnalyses::none();
     }
+    Memo[C] = Best;
+    return Best;
+}
+
+// Catena shift/add/sub piu' economica per x * C, vuota se C non ne ha una.
+// KeepsFlags: la mul ha nuw/nsw che una catena di sole shl e add
+// conserverebbe; a parita' di costo si sceglie quella (x * 6 diventa
+// (x << 2) + (x << 1) e non (x << 3) - (x << 1)), perche' i flag permettono
+// ad altri pass di semplificare ancora, ad esempio nelle comparazioni o negli
+// indirizzi
+static MulChain findBestMulChain(const APInt &C, const StrengthReductionCostModel &CM, bool KeepsFlags = false) {
+    unsigned BW = C.getBitWidth();
+    if (BW > 64 || C.isZero() || C.isOne())
+        return MulChain();
+
+    MulChain Best;
+    if (C.isPowerOf2()) {
+        Best.add(MulChainStep::Shl, 0, C.logBase2());
+        Best.computeCost(CM);
+    } else {
+        DenseMap<uint64_t, MulChain> Memo;
+        Best = buildNAFChain(C, CM);
+        if (!C.isNegative() && C.getActiveBits() < 63) {
+            MulChain Pos = findPositiveMulChain(C.getZExtValue(), BW, CM, Memo);
+            if (Pos.isBetterThan(Best, CM))
+                Best = std::move(Pos);
+        } else if (C.isNegative() && !C.isMinSignedValue() && (-C).getActiveBits() < 63) {
+            MulChain Neg = findPositiveMulChain((-C).getZExtValue(), BW, CM, Memo);
+            Neg.add(MulChainStep::Neg, Neg.last(), 0);
+            Neg.computeCost(CM);
+            if (Neg.isBetterThan(Best, CM))
+                Best = std::move(Neg);
+        }
+        if (KeepsFlags && !Best.isAddOnly() && !C.isNegative() && C.getActiveBits() < 63) {
+            DenseMap<uint64_t, MulChain> AddOnlyMemo;
+            MulChain AddOnly = findPositiveMulChain(C.getZExtValue(), BW, CM, AddOnlyMemo, /*AddOnly=*/true);
+            if (AddOnly.getPrimaryCost(CM) <= Best.getPrimaryCost(CM) && AddOnly.Steps.size() <= CM.MaxSteps)
+                Best = std::move(AddOnly);
+        }
+    }
+    return Best;
+}
+
+// Restituisce la catena per x * C se il modello di costo la ritiene
+// migliore della mul
+static Optional<MulChain> findMulChain(const APInt &C, const StrengthReductionCostModel &CM) {
+    MulChain Best = findBestMulChain(C, CM);
+    if (!Best.isProfitable(CM))
+        return None;
+    return Best;
+}
+
+// NUW/NSW sono i flag della mul: se la catena usa solo shl e add ogni valore
+// intermedio e' x * c con 0 < c <= C, quindi non va in overflow se non ci va
+// il prodotto e i flag si possono propagare (NSW solo per C positivo).
+// Con Products i passi gia' calcolati altrove vengono riusati.
+static Value *emitMulChain(const MulChain &Chain, Value *X, IRBuilderBase &B, ConstantPool &Pool,
+                           PartialProductCache *Products = nullptr, bool NUW = false, bool NSW = false) {
+    if (!Chain.isAddOnly())
+        NUW = NSW = false;
+    unsigned BW = X->getType()->getScalarSizeInBits();
+    const Instruction *InsertPt = B.GetInsertPoint() != B.GetInsertBlock()->end() ? &*B.GetInsertPoint() : nullptr;
+    if (!InsertPt)
+        Products = nullptr;
+    SmallVector<Value *, 8> Vals{X};
+    // Coefficiente di x di ogni valore della catena
+    SmallVector<APInt, 8> Coeffs{APInt(BW, 1)};
+    for (const MulChainStep &S : Chain.Steps) {
+        APInt C;
+        switch (S.Op) {
+        case MulChainStep::Shl:
+            C = Coeffs[S.LHS].shl(S.RHS);
+            break;
+        case MulChainStep::Add:
+            C = Coeffs[S.LHS] + Coeffs[S.RHS];
+            break;
+        case MulChainStep::Sub:
+            C = Coeffs[S.LHS] - Coeffs[S.RHS];
+            break;
+        case MulChainStep::Neg:
+            C = -Coeffs[S.LHS];
+            break;
+        }
+        Coeffs.push_back(C);
+        if (Value *Existing = Products ? Products->lookup(X, C, InsertPt, NUW, NSW) : nullptr) {
+            Vals.push_back(Existing);
+            continue;
+        }
+
+        Value *V = nullptr;
+        switch (S.Op) {
+        case MulChainStep::Shl:
+            V = B.CreateShl(Vals[S.LHS], Pool.get(X->getType(), S.RHS), "shift", NUW, NSW);
+            break;
+        case MulChainStep::Add:
+            V = B.CreateAdd(Vals[S.LHS], Vals[S.RHS], "add", NUW, NSW);
+            break;
+        case MulChainStep::Sub:
+            V = B.CreateSub(Vals[S.LHS], Vals[S.RHS], "sub");
+            break;
+        case MulChainStep::Neg:
+            V = B.CreateNeg(Vals[S.LHS], "neg");
+            break;
+        }
+        if (Products)
+            Products->insert(X, C, V);
+        Vals.push_back(V);
+    }
+    return Vals.back();
+}
+
+// Parte alta (BW bit) del prodotto a 2*BW bit x * M
+static Value *emitMulHigh(IRBuilderBase &B, ConstantPool &Pool, Value *X, const APInt &M, bool Signed) {
+    unsigned BW = M.getBitWidth();
+    Type *WideTy = X->getType()->getWithNewBitWidth(2 * BW);
+    Value *WideX = Signed ? B.CreateSExt(X, WideTy) : B.CreateZExt(X, WideTy);
+    Value *Prod = B.CreateMul(WideX, Pool.get(WideTy, Signed ? M.sext(2 * BW) : M.zext(2 * BW)), "mulh");
+    return B.CreateTrunc(B.CreateLShr(Prod, Pool.get(WideTy, BW)), X->getType());
+}
+
+// Divisione esatta: shift dei fattori 2 e moltiplicazione per l'inverso
+// moltiplicativo della parte dispari del divisore (mod 2^BW)
+static Value *emitExactDiv(IRBuilderBase &B, ConstantPool &Pool, Value *X, const APInt &D, bool Signed) {
+    unsigned BW = D.getBitWidth();
+    Type *Ty = X->getType();
+    unsigned Shift = D.countTrailingZeros();
+    if (Shift)
+        X = Signed ? B.CreateAShr(X, Pool.get(Ty, Shift), "ashr", /*isExact=*/true)
+                   : B.CreateLShr(X, Pool.get(Ty, Shift), "lshr", /*isExact=*/true);
+    APInt Odd = Signed ? D.ashr(Shift) : D.lshr(Shift);
+    if (Odd.isOne())
+        return X;
+    APInt Inverse = Odd.zext(BW + 1).multiplicativeInverse(APInt::getOneBitSet(BW + 1, BW)).trunc(BW);
+    return B.CreateMul(X, Pool.get(Ty, Inverse), "inv");
+}
+
+// Quoziente senza segno x / D (Granlund-Montgomery). LeadingZeros sono i bit
+// alti di x noti a zero: restringono il dividendo e spesso evitano la correzione
+static Value *emitUDivByConstant(IRBuilderBase &B, ConstantPool &Pool, Value *X, const APInt &D,
+                                 unsigned LeadingZeros = 0) {
+    Type *Ty = X->getType();
+    if (D.isOne())
+        return X;
+    if (D.isPowerOf2())
+        return B.CreateLShr(X, Pool.get(Ty, D.logBase2()), "lshr");
+    // Con il bit alto del divisore a 1 il quoziente puo' valere solo 0 o 1
+    if (D.isNegative())
+        return B.CreateZExt(B.CreateICmpUGE(X, Pool.get(Ty, D)), Ty);
+
+    UnsignedDivisonByConstantInfo Magics = UnsignedDivisonByConstantInfo::get(D, LeadingZeros);
+    unsigned PreShift = 0;
+    // Per divisori pari lo shift preventivo del dividendo evita la correzione
+    if (Magics.IsAdd && !D[0]) {
+        PreShift = D.countTrailingZeros();
+        Magics = UnsignedDivisonByConstantInfo::get(D.lshr(PreShift), LeadingZeros + PreShift);
+    }
+    if (PreShift)
+        X = B.CreateLShr(X, Pool.get(Ty, PreShift), "lshr");
+    Value *Q = emitMulHigh(B, Pool, X, Magics.Magic, /*Signed=*/false);
+    if (!Magics.IsAdd)
+        return Magics.ShiftAmount ? B.CreateLShr(Q, Pool.get(Ty, Magics.ShiftAmount), "lshr") : Q;
+    Value *NPQ = B.CreateLShr(B.CreateSub(X, Q), Pool.get(Ty, 1));
+    Q = B.CreateAdd(NPQ, Q);
+    return Magics.ShiftAmount > 1 ? B.CreateLShr(Q, Pool.get(Ty, Magics.ShiftAmount - 1), "lshr") : Q;
+}
+
+// Quoziente con segno x / D, arrotondato verso zero
+static Value *emitSDivByConstant(IRBuilderBase &B, ConstantPool &Pool, Value *X, const APInt &D) {
+    unsigned BW = D.getBitWidth();
+    Type *Ty = X->getType();
+    if (D.isOne())
+        return X;
+    if (D.isAllOnes())
+        return B.CreateNeg(X, "neg");
+
+    APInt AbsD = D.abs();
+    if (AbsD.isPowerOf2()) {
+        // Per dividendi negativi si somma 2^k - 1 prima dello shift
+        unsigned K = AbsD.logBase2();
+        Value *Sign = B.CreateAShr(X, Pool.get(Ty, BW - 1), "sign");
+        Value *Bias = B.CreateLShr(Sign, Pool.get(Ty, BW - K), "bias");
+        Value *Q = B.CreateAShr(B.CreateAdd(X, Bias), Pool.get(Ty, K), "ashr");
+        return D.isNegative() ? B.CreateNeg(Q, "neg") : Q;
+    }
+
+    SignedDivisionByConstantInfo Magics = SignedDivisionByConstantInfo::get(D);
+    Value *Q = emitMulHigh(B, Pool, X, Magics.Magic, /*Signed=*/true);
+    if (D.isStrictlyPositive() && Magics.Magic.isNegative())
+        Q = B.CreateAdd(Q, X);
+    else if (D.isNegative() && Magics.Magic.isStrictlyPositive())
+        Q = B.CreateSub(Q, X);
+    if (Magics.ShiftAmount)
+        Q = B.CreateAShr(Q, Pool.get(Ty, Magics.ShiftAmount), "ashr");
+    return B.CreateAdd(Q, B.CreateLShr(Q, Pool.get(Ty, BW - 1), "sign"));
+}
+
+// Divisione per costante da espandere. Opcode e' quello effettivo: con
+// dividendo non negativo e divisore positivo sdiv/srem coincidono con
+// udiv/urem, che hanno sequenze piu' corte
+struct DivRemByConstant {
+    unsigned Opcode;
+    bool Exact;
+    Value *X;
+    APInt D;
+    // Bit alti del dividendo noti a zero
+    unsigned LeadingZeros;
+
+    bool isSigned() const { return Opcode == Instruction::SDiv || Opcode == Instruction::SRem; }
+    bool isRem() const { return Opcode == Instruction::URem || Opcode == Instruction::SRem; }
 };
 
+// Costo stimato della sequenza emessa da lowerDivRemByConstant, nella metrica
+// del modello: per la latenza la sequenza e' quasi tutta una catena seriale
+static unsigned estimateDivRemCost(const DivRemByConstant &Div, const StrengthReductionCostModel &CM) {
+    const APInt &D = Div.D;
+    bool Signed = Div.isSigned();
+    bool Rem = Div.isRem();
+    APInt AbsD = Signed ? D.abs() : D;
+    if (AbsD.isOne())
+        return 0;
+    if (AbsD.isPowerOf2()) {
+        if (!Signed)
+            return CM.ShiftCost;
+        // sign, bias, add, ashr (e neg) oppure sign, bias, add, and, sub
+        return Rem ? 2 * CM.ShiftCost + 3 * CM.AddCost : 3 * CM.ShiftCost + (D.isNegative() ? 2 : 1) * CM.AddCost;
+    }
+    if (Div.Exact && !Rem)
+        return CM.ShiftCost + CM.MulCost;
+    // Estensione, mulh, shift, troncamento e correzioni; il resto aggiunge mul e sub
+    unsigned Quotient = CM.MulCost + 2 * CM.ShiftCost + 3 * CM.AddCost;
+    return Rem ? Quotient + CM.MulCost + CM.AddCost : Quotient;
+}
+
+// Motivo per cui la divisione resta tale, o nullptr se l'espansione conviene
+static const char *getDivRemRejection(const DivRemByConstant &Div, const StrengthReductionCostModel &CM) {
+    const APInt &D = Div.D;
+    if (D.getBitWidth() > 64)
+        return "wider than 64 bits";
+    if (CM.optimizesForSize()) {
+        if (estimateDivRemCost(Div, CM) > CM.DivCost)
+            return "expansion larger than the division";
+    } else if (CM.DivCost <= CM.MulCost && !D.abs().isPowerOf2()) {
+        return "division not slower than multiplication on this target";
+    } else if (estimateDivRemCost(Div, CM) > CM.DivCost) {
+        return "expansion slower than the division";
+    }
+    return nullptr;
+}
+
+// Sequenza equivalente alla divisione; getDivRemRejection deve averla gia'
+// ritenuta conveniente
+static Value *lowerDivRemByConstant(const DivRemByConstant &Div, const StrengthReductionCostModel &CM,
+                                    IRBuilderBase &B, ConstantPool &Pool) {
+    const APInt &D = Div.D;
+    unsigned BW = D.getBitWidth();
+
+    Value *X = Div.X;
+    Type *Ty = X->getType();
+    switch (Div.Opcode) {
+    case Instruction::UDiv:
+        return Div.Exact ? emitExactDiv(B, Pool, X, D, /*Signed=*/false)
+                         : emitUDivByConstant(B, Pool, X, D, Div.LeadingZeros);
+    case Instruction::SDiv:
+        if (Div.Exact && !D.isAllOnes())
+            return emitExactDiv(B, Pool, X, D, /*Signed=*/true);
+        return emitSDivByConstant(B, Pool, X, D);
+    case Instruction::URem:
+        if (D.isPowerOf2())
+            return B.CreateAnd(X, Pool.get(Ty, D - 1), "and");
+        break;
+    case Instruction::SRem:
+        if (D.abs().isPowerOf2() || D.isAllOnes()) {
+            if (D.isOne() || D.isAllOnes())
+                return Pool.get(Ty, 0);
+            // x - ((x + bias) & -2^k): il segno del divisore non conta
+            unsigned K = D.abs().logBase2();
+            Value *Sign = B.CreateAShr(X, Pool.get(Ty, BW - 1), "sign");
+            Value *Bias = B.CreateLShr(Sign, Pool.get(Ty, BW - K), "bias");
+            Value *Trunc = B.CreateAnd(B.CreateAdd(X, Bias), Pool.get(Ty, APInt::getHighBitsSet(BW, BW - K)));
+            return B.CreateSub(X, Trunc, "rem");
+        }
+        break;
+    default:
+        return nullptr;
+    }
+
+    // Resto generico: x - (x / D) * D
+    Value *Q = Div.isSigned() ? emitSDivByConstant(B, Pool, X, D) : emitUDivByConstant(B, Pool, X, D, Div.LeadingZeros);
+    Value *Prod;
+    if (auto Chain = findMulChain(D, CM))
+        Prod = emitMulChain(*Chain, Q, B, Pool);
+    else
+        Prod = B.CreateMul(Q, Pool.get(Ty, D));
+    return B.CreateSub(X, Prod, "rem");
+}
+
+// Costanti per lane di un vettore non uniforme (gli splat li riconosce gia'
+// m_APInt); false se qualche lane e' undef o il vettore e' scalabile
+static bool getConstantLanes(Value *V, SmallVectorImpl<APInt> &Lanes) {
+    auto *C = dyn_cast<Constant>(V);
+    auto *VTy = dyn_cast<FixedVectorType>(V->getType());
+    if (!C || !VTy)
+        return false;
+    for (unsigned i = 0, e = VTy->getNumElements(); i != e; ++i) {
+        auto *Elt = dyn_cast_or_null<ConstantInt>(C->getAggregateElement(i));
+        if (!Elt)
+            return false;
+        Lanes.push_back(Elt->getValue());
+    }
+    return true;
+}
+
+// Scompone C come 2^Hi + 2^Lo (Sub = false) o 2^Hi - 2^Lo (Sub = true)
+static bool splitIntoTwoPowers(const APInt &C, bool Sub, unsigned &Hi, unsigned &Lo) {
+    unsigned BW = C.getBitWidth();
+    if (C.isPowerOf2()) {
+        unsigned K = C.logBase2();
+        if (Sub ? K + 1 >= BW : K == 0)
+            return false;
+        Hi = Sub ? K + 1 : K - 1;
+        Lo = Sub ? K : K - 1;
+        return true;
+    }
+    if (!Sub) {
+        if (C.countPopulation() != 2)
+            return false;
+        Hi = C.logBase2();
+        Lo = C.countTrailingZeros();
+        return true;
+    }
+    // Una sola sequenza di uni, dal bit Lo al bit Hi - 1
+    if (C.isNegative() || !C.isShiftedMask())
+        return false;
+    Hi = C.logBase2() + 1;
+    Lo = C.countTrailingZeros();
+    return true;
+}
+
+// x << a per lane; uno shift di 0 in tutte le lane e' x stesso
+static Value *createLaneShl(Value *X, ArrayRef<unsigned> Amounts, IRBuilderBase &B, ConstantPool &Pool, bool NUW,
+                            bool NSW) {
+    if (all_of(Amounts, [](unsigned A) { return A == 0; }))
+        return X;
+    return B.CreateShl(X, Pool.getLanes(X->getType(), Amounts), "shift", NUW, NSW);
+}
+
+// Mul per un vettore di costanti diverse per lane: una catena comune a tutte
+// le lane con shift per lane, x << a oppure (x << a) +- (x << b). Conviene
+// solo dove il target ha shift variabili economici (AVX2, NEON): altrove
+// VarShiftCost vale quanto una mul
+static Value *reduceMulByLanes(Instruction &I, Value *X, ArrayRef<APInt> Lanes, IRBuilderBase &B,
+                               ConstantPool &Pool, const StrengthReductionCostModel &CM) {
+    if (Lanes.front().getBitWidth() > 64)
+        return nullptr;
+    bool NSW = I.hasNoSignedWrap() && none_of(Lanes, [](const APInt &C) { return C.isNegative(); });
+    auto isCheaper = [&](unsigned Latency, unsigned Size) {
+        return CM.optimizesForSize() ? Size <= CM.MulCost : Latency < CM.MulCost;
+    };
+
+    SmallVector<unsigned, 16> Hi, Lo;
+    if (all_of(Lanes, [](const APInt &C) { return C.isPowerOf2(); })) {
+        if (!isCheaper(CM.VarShiftCost, CM.VarShiftCost))
+            return nullptr;
+        for (const APInt &C : Lanes)
+            Hi.push_back(C.logBase2());
+        return createLaneShl(X, Hi, B, Pool, I.hasNoUnsignedWrap(), NSW);
+    }
+    if (!isCheaper(CM.VarShiftCost + CM.AddCost, 2 * CM.VarShiftCost + CM.AddCost))
+        return nullptr;
+    for (bool Sub : {false, true}) {
+        Hi.clear();
+        Lo.clear();
+        bool Split = all_of(Lanes, [&](const APInt &C) {
+            unsigned H, L;
+            if (!splitIntoTwoPowers(C, Sub, H, L))
+                return false;
+            Hi.push_back(H);
+            Lo.push_back(L);
+            return true;
+        });
+        if (!Split)
+            continue;
+        bool NUW = !Sub && I.hasNoUnsignedWrap();
+        Value *ShHi = createLaneShl(X, Hi, B, Pool, NUW, !Sub && NSW);
+        Value *ShLo = createLaneShl(X, Lo, B, Pool, NUW, !Sub && NSW);
+        return Sub ? B.CreateSub(ShHi, ShLo, "sub") : B.CreateAdd(ShHi, ShLo, "add", NUW, NSW);
+    }
+    return nullptr;
+}
+
 // Secondo Pass: Strength Reduction
+// Su vettori le costanti splat seguono la stessa strada degli scalari, con i
+// costi di TTI per il tipo vettoriale
+static Value *reduceMul(Instruction &I, IRBuilderBase &B, RewriteContext &Ctx) {
+    Value *op0 = I.getOperand(0);
+    Value *op1 = I.getOperand(1);
+    if (isa<Constant>(op0)) std::swap(op0, op1);
+    const APInt *C;
+    if (!match(op1, m_APInt(C))) {
+        SmallVector<APInt, 16> Lanes;
+        if (!getConstantLanes(op1, Lanes))
+            return nullptr;
+        return reduceMulByLanes(I, op0, Lanes, B, Ctx.Constants, Ctx.getCostModel(I));
+    }
+    if (C->isZero() || C->isOne())
+        return nullptr;
+    // La worklist visita gli operandi prima degli utenti: con la riassociazione
+    // nella stessa tabella la mul interna di (x * 3) * 5 aspetta la radice,
+    // che la unisce all'esterna in x * 15, invece di essere espansa da sola
+    if (Ctx.Reassociates && isInReassociationTree(I, Ctx))
+        return nullptr;
+    const StrengthReductionCostModel &CM = Ctx.getCostModel(I);
+    bool NSW = I.hasNoSignedWrap() && !C->isNegative(); // shl nsw x, BW - 1 e' poison per x = 1
+    MulChain Chain = findBestMulChain(*C, CM, I.hasNoUnsignedWrap() || NSW);
+    if (Chain.isProfitable(CM))
+        return emitMulChain(Chain, op0, B, Ctx.Constants, &Ctx.getPartialProducts(), I.hasNoUnsignedWrap(), NSW);
+
+    Ctx.emitMissed(I, [&]() {
+        OptimizationRemarkMissed R(DEBUG_TYPE, "MulNotReduced", &I);
+        R << "mul by " << ore::NV("Constant", op1) << " not lowered: ";
+        if (Chain.Steps.empty())
+            R << "no shift/add decomposition";
+        else if (Chain.Steps.size() > CM.MaxSteps)
+            R << "chain of " << ore::NV("Steps", unsigned(Chain.Steps.size())) << " steps exceeds the limit of "
+              << ore::NV("MaxSteps", CM.MaxSteps);
+        else if (CM.optimizesForSize())
+            R << "chain size " << ore::NV("ChainCost", Chain.Size) << " exceeds mul size "
+              << ore::NV("MulCost", CM.MulCost) << (CM.ColdCode ? " in cold code" : "");
+        else
+            R << "chain cost " << ore::NV("ChainCost", Chain.Latency) << " not below mul cost "
+              << ore::NV("MulCost", CM.MulCost);
+        return R;
+    });
+    return nullptr;
+}
+
+// Divisione per un vettore non uniforme: solo divisori potenze di due, con
+// lshr per lane per il quoziente e una and per il resto
+static Value *reduceDivRemByLanes(const DivRemByConstant &Div, ArrayRef<APInt> Lanes, IRBuilderBase &B,
+                                  ConstantPool &Pool, const StrengthReductionCostModel &CM) {
+    if (Div.isSigned() || !all_of(Lanes, [](const APInt &D) { return D.isPowerOf2(); }))
+        return nullptr;
+    Type *Ty = Div.X->getType();
+    if (Div.isRem()) {
+        SmallVector<uint64_t, 16> Masks;
+        for (const APInt &D : Lanes)
+            Masks.push_back(D.getZExtValue() - 1);
+        return B.CreateAnd(Div.X, Pool.getLanes<uint64_t>(Ty, Masks), "and");
+    }
+    if (CM.optimizesForSize() ? CM.VarShiftCost > CM.DivCost : CM.VarShiftCost >= CM.DivCost)
+        return nullptr;
+    SmallVector<unsigned, 16> Shifts;
+    for (const APInt &D : Lanes)
+        Shifts.push_back(D.logBase2());
+    return B.CreateLShr(Div.X, Pool.getLanes<unsigned>(Ty, Shifts), "lshr", Div.Exact);
+}
+
+// Confronto di un quoziente senza segno con una costante: i quozienti che
+// soddisfano il predicato formano un intervallo [L, U), e x / C vi cade se e
+// solo se x cade in [L * C, U * C). icmp ult (udiv x, 10), 4 diventa
+// icmp ult x, 40 e la divisione sparisce.
+struct UDivCompare {
+    Value *X;
+    ICmpInst::Predicate Pred;
+    APInt K;
+    APInt C;
+};
+
+// udiv x, C oppure lshr x, k confrontato con una costante, in entrambi gli ordini
+static Optional<UDivCompare> matchUDivCompare(const User *U) {
+    auto *Cmp = dyn_cast<ICmpInst>(U);
+    if (!Cmp)
+        return None;
+    ICmpInst::Predicate Pred = Cmp->getPredicate();
+    Value *Q = Cmp->getOperand(0);
+    const APInt *K, *C;
+    if (!match(Cmp->getOperand(1), m_APInt(K))) {
+        if (!match(Q, m_APInt(K)))
+            return None;
+        Q = Cmp->getOperand(1);
+        Pred = ICmpInst::getSwappedPredicate(Pred);
+    }
+    Value *X;
+    if (match(Q, m_UDiv(m_Value(X), m_APInt(C))) && !C->isZero())
+        return UDivCompare{X, Pred, *K, *C};
+    if (match(Q, m_LShr(m_Value(X), m_APInt(C))) && C->ult(C->getBitWidth()))
+        return UDivCompare{X, Pred, *K, APInt::getOneBitSet(C->getBitWidth(), C->getZExtValue())};
+    return None;
+}
+
+// Dividendi il cui quoziente per C cade in Q
+static ConstantRange getUDivDividendRange(const ConstantRange &Q, const APInt &C) {
+    if (Q.isEmptySet() || Q.isFullSet())
+        return Q;
+    if (Q.isWrappedSet())
+        return getUDivDividendRange(Q.inverse(), C).inverse();
+    unsigned BW = C.getBitWidth();
+    // Calcolo su 2*BW bit: U * C puo' superare 2^BW
+    APInt Limit = APInt::getOneBitSet(2 * BW, BW);
+    APInt Lo = Q.getLower().zext(2 * BW) * C.zext(2 * BW);
+    APInt Hi = (Q.getUpper().isZero() ? Limit : Q.getUpper().zext(2 * BW)) * C.zext(2 * BW);
+    if (Lo.uge(Limit))
+        return ConstantRange::getEmpty(BW);
+    return ConstantRange::getNonEmpty(Lo.trunc(BW), APIntOps::umin(Hi, Limit).trunc(BW));
+}
+
+static Value *reduceUDivCompare(Instruction &I, IRBuilderBase &B, RewriteContext &Ctx) {
+    Optional<UDivCompare> M = matchUDivCompare(&I);
+    if (!M)
+        return nullptr;
+    Ctx.lockIR();
+    ConstantRange X = getUDivDividendRange(ConstantRange::makeExactICmpRegion(M->Pred, M->K), M->C);
+    if (X.isEmptySet() || X.isFullSet())
+        return ConstantInt::getBool(I.getType(), X.isFullSet());
+    CmpInst::Predicate Pred;
+    APInt RHS, Offset;
+    X.getEquivalentICmp(Pred, RHS, Offset);
+    Type *Ty = M->X->getType();
+    Value *V = Offset.isZero() ? M->X : B.CreateAdd(M->X, Ctx.Constants.get(Ty, Offset), "off");
+    return B.CreateICmp(Pred, V, Ctx.Constants.get(Ty, RHS), "cmp");
+}
+
+static Value *reduceDivRem(Instruction &I, IRBuilderBase &B, RewriteContext &Ctx) {
+    Value *Divisor = I.getOperand(1);
+    const APInt *C;
+    SmallVector<APInt, 16> Lanes;
+    if (match(Divisor, m_APInt(C))) {
+        if (C->isZero())
+            return nullptr;
+    } else if (!getConstantLanes(Divisor, Lanes) || any_of(Lanes, [](const APInt &D) { return D.isZero(); })) {
+        return nullptr;
+    }
+    // Una udiv usata solo da confronti con costanti sparisce con reduceUDivCompare,
+    // se la famiglia udiv-cmp e' attiva
+    if (I.getOpcode() == Instruction::UDiv && (!Ctx.Options || Ctx.Options->UDivCompare) && !I.use_empty() &&
+        all_of(I.users(), [](const User *U) { return matchUDivCompare(U).hasValue(); }))
+        return nullptr;
+    DivRemByConstant Div{I.getOpcode(), I.isExact(), I.getOperand(0), Lanes.empty() ? *C : APInt(), 0};
+    unsigned BW = I.getType()->getScalarSizeInBits();
+    if (BW <= 64) {
+        KnownBits Known = Ctx.computeKnownBits(Div.X, &I);
+        Div.LeadingZeros = Known.countMinLeadingZeros();
+        bool PositiveDivisor = Lanes.empty() ? Div.D.isStrictlyPositive()
+                                             : all_of(Lanes, [](const APInt &D) { return D.isStrictlyPositive(); });
+        if (Div.isSigned() && PositiveDivisor && (Known.isNonNegative() || Ctx.isNonNegative(Div.X, I)))
+            Div.Opcode = Div.isRem() ? Instruction::URem : Instruction::UDiv;
+    }
+    const StrengthReductionCostModel &CM = Ctx.getCostModel(I);
+    if (!Lanes.empty()) {
+        if (BW > 64)
+            return nullptr;
+        return reduceDivRemByLanes(Div, Lanes, B, Ctx.Constants, CM);
+    }
+    const char *Reason = getDivRemRejection(Div, CM);
+    if (!Reason)
+        return lowerDivRemByConstant(Div, CM, B, Ctx.Constants);
+
+    Ctx.emitMissed(I, [&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "DivRemNotReduced", &I)
+               << ore::NV("Opcode", I.getOpcodeName()) << " by " << ore::NV("Constant", Divisor)
+               << " not lowered: " << Reason << (CM.ColdCode ? " in cold code" : "");
+    });
+    return nullptr;
+}
+
+// (x / 2^k) * 2^k e (x >> k) << k -> and x, -2^k: restano solo i bit alti.
+// sdiv arrotonda verso zero, quindi per i dividendi negativi si somma prima
+// 2^k - 1 come nella sdiv per potenze di due
+static Value *reduceRoundDown(Instruction &I, IRBuilderBase &B, RewriteContext &Ctx) {
+    Value *Op0 = I.getOperand(0), *Op1 = I.getOperand(1);
+    if (I.getOpcode() == Instruction::Mul && isa<Constant>(Op0))
+        std::swap(Op0, Op1);
+    Type *Ty = I.getType();
+    unsigned BW = Ty->getScalarSizeInBits();
+    const APInt *C;
+    if (!match(Op1, m_APInt(C)))
+        return nullptr;
+    unsigned K;
+    if (I.getOpcode() == Instruction::Mul) {
+        if (!C->isPowerOf2())
+            return nullptr;
+        K = C->logBase2();
+    } else {
+        if (C->uge(BW))
+            return nullptr;
+        K = C->getZExtValue();
+    }
+    if (K == 0)
+        return nullptr;
+
+    Value *X;
+    const APInt *D;
+    bool Signed = false;
+    if (match(Op0, m_CombineOr(m_LShr(m_Value(X), m_SpecificInt(K)), m_AShr(m_Value(X), m_SpecificInt(K))))) {
+    } else if (match(Op0, m_UDiv(m_Value(X), m_APInt(D))) && D->isPowerOf2() && D->logBase2() == K) {
+    } else if (match(Op0, m_SDiv(m_Value(X), m_APInt(D))) && D->isStrictlyPositive() && D->isPowerOf2() &&
+               D->logBase2() == K) {
+        Signed = true;
+    } else {
+        return nullptr;
+    }
+    // Con exact i bit bassi sono gia' zero
+    if (cast<PossiblyExactOperator>(Op0)->isExact())
+        return X;
+    Ctx.lockIR();
+    ConstantPool &Pool = Ctx.Constants;
+    if (Signed) {
+        Value *Sign = B.CreateAShr(X, Pool.get(Ty, BW - 1), "sign");
+        X = B.CreateAdd(X, B.CreateLShr(Sign, Pool.get(Ty, BW - K), "bias"));
+    }
+    return B.CreateAnd(X, Pool.get(Ty, APInt::getHighBitsSet(BW, BW - K)), "and");
+}
+
+STATISTIC(NumMulReduced, "mul per costante espanse in shift/add/sub");
+STATISTIC(NumDivRemReduced, "div/rem per costante espanse");
+STATISTIC(NumRoundDownReduced, "(x / 2^k) * 2^k sostituite da una and");
+STATISTIC(NumUDivCompareReduced, "confronti di un quoziente udiv sostituiti da confronti del dividendo");
+
+// Solo le famiglie abilitate, nello stesso ordine
+static RuleTable buildStrengthReductionRules(const StrengthReductionOptions &Options) {
+    RuleTable Rules;
+    if (Options.RoundDown)
+        Rules.add({Instruction::Mul, Instruction::Shl}, reduceRoundDown, "RoundDownReduced", NumRoundDownReduced);
+    if (Options.Mul)
+        Rules.add({Instruction::Mul}, reduceMul, "MulReduced", NumMulReduced);
+    if (Options.Div)
+        Rules.add({Instruction::UDiv, Instruction::SDiv, Instruction::URem, Instruction::SRem}, reduceDivRem,
+                  "DivRemReduced", NumDivRemReduced);
+    if (Options.UDivCompare)
+        Rules.add({Instruction::ICmp}, reduceUDivCompare, "UDivCompareReduced", NumUDivCompareReduced);
+    return Rules;
+}
+
+static const RuleTable &getStrengthReductionRules() {
+    static const RuleTable Rules = buildStrengthReductionRules(StrengthReductionOptions());
+    return Rules;
+}
+
+// strength-reduction<max-chain=3;no-div;no-vector;cost=code-size>
+static Expected<StrengthReductionOptions> parseStrengthReductionOptions(StringRef Params) {
+    StrengthReductionOptions Options;
+    while (!Params.empty()) {
+        StringRef Param;
+        std::tie(Param, Params) = Params.split(';');
+        bool Enable = !Param.consume_front("no-");
+        bool *Family = StringSwitch<bool *>(Param)
+                           .Case("mul", &Options.Mul)
+                           .Case("div", &Options.Div)
+                           .Case("round-down", &Options.RoundDown)
+                           .Case("udiv-cmp", &Options.UDivCompare)
+                           .Case("vector", &Options.Vector)
+                           .Default(nullptr);
+        if (Family) {
+            *Family = Enable;
+            continue;
+        }
+        unsigned MaxChain;
+        if (Enable && Param.consume_front("max-chain=")) {
+            if (Param.getAsInteger(10, MaxChain))
+                return make_error<StringError>(
+                    formatv("invalid strength-reduction max-chain '{0}'", Param).str(), inconvertibleErrorCode());
+            Options.MaxChain = MaxChain;
+            continue;
+        }
+        if (Enable && Param.consume_front("cost=")) {
+            Options.CostKind = StringSwitch<Optional<TargetTransformInfo::TargetCostKind>>(Param)
+                                   .Case("throughput", TargetTransformInfo::TCK_RecipThroughput)
+                                   .Case("latency", TargetTransformInfo::TCK_Latency)
+                                   .Case("code-size", TargetTransformInfo::TCK_CodeSize)
+                                   .Case("size-latency", TargetTransformInfo::TCK_SizeAndLatency)
+                                   .Default(None);
+            if (!Options.CostKind)
+                return make_error<StringError>(
+                    formatv("invalid strength-reduction cost '{0}'", Param).str(), inconvertibleErrorCode());
+            continue;
+        }
+        return make_error<StringError>(formatv("invalid strength-reduction parameter '{0}'", Param).str(),
+                                       inconvertibleErrorCode());
+    }
+    return Options;
+}
+
 struct StrengthReductionPass : public PassInfoMixin<StrengthReductionPass> {
-    PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
-        for (auto &BB : F) {
-            for (auto it = BB.begin(), end = BB.end(); it != end;) {
-                Instruction *I = &*it++;
-                if (auto *binOp = dyn_cast<BinaryOperator>(I)) {
-                    if (binOp->getOpcode() == Instruction::Mul) {
-                        Value *op0 = binOp->getOperand(0);
-                        Value *op1 = binOp->getOperand(1);
-                        if (auto *C = dyn_cast<ConstantInt>(op0)) {
-                            if (C->equalsInt(15)) std::swap(op0, op1);
-                        }
-                        if (auto *C = dyn_cast<ConstantInt>(op1)) {
-                            if (C->equalsInt(15)) {
-                                auto *shiftInst = BinaryOperator::CreateShl(op0, ConstantInt::get(op0->getType(), 4), "shift", binOp);
-                                auto *newInst = BinaryOperator::CreateSub(shiftInst, op0, "sub", binOp);
-                                binOp->replaceAllUsesWith(newInst);
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                    }
-                    if (binOp->getOpcode() == Instruction::SDiv) {
-                        Value *op0 = binOp->getOperand(0);
-                        Value *op1 = binOp->getOperand(1);
-                        if (auto *C = dyn_cast<ConstantInt>(op1)) {
-                            if (C->equalsInt(8)) {
-                                auto *shiftInst = BinaryOperator::CreateAShr(op0, ConstantInt::get(op0->getType(), 3), "ashr", binOp);
-                                binOp->replaceAllUsesWith(shiftInst);
-                                binOp->eraseFromParent();
-                                continue;
-                            }
-                        }
-                    }
-                }
+    StrengthReductionOptions Options;
+    RuleTable Rules;
+
+    explicit StrengthReductionPass(StrengthReductionOptions Options = StrengthReductionOptions())
+        : Options(Options), Rules(buildStrengthReductionRules(Options)) {}
+
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        return runRules(F, AM, name(), Rules, &Options);
+    }
+};
+
+// Terzo Pass: Multi-Instruction Optimization (ora supporta store/load)
+// Le regole seguono le catene use-def invece dell'adiacenza delle istruzioni,
+// quindi istruzioni intermedie (GEP, intrinsic di debug, store su altri
+// oggetti) non impediscono il match.
+
+// Numero massimo di istruzioni esaminate risalendo da un load
+static constexpr unsigned MaxForwardingScan = 32;
+
+// Due puntatori a oggetti identificati distinti (alloca, globali, argomenti
+// noalias) non possono riferirsi alla stessa memoria
+static bool isDistinctObject(const Value *P1, const Value *P2) {
+    const Value *O1 = getUnderlyingObject(P1);
+    const Value *O2 = getUnderlyingObject(P2);
+    return O1 != O2 && isIdentifiedObject(O1) && isIdentifiedObject(O2);
+}
+
+// Valore scritto dall'ultimo store sullo stesso indirizzo di L nello stesso
+// blocco, se nessuna istruzione intermedia puo' sovrascriverlo
+static Value *findForwardedStoreInBlock(LoadInst *L) {
+    Value *Ptr = L->getPointerOperand();
+    unsigned Scanned = 0;
+    for (Instruction *I = L->getPrevNode(); I && Scanned < MaxForwardingScan; I = I->getPrevNode(), ++Scanned) {
+        if (auto *S = dyn_cast<StoreInst>(I)) {
+            if (S->getPointerOperand()->stripPointerCasts() == Ptr->stripPointerCasts()) {
+                Value *Stored = S->getValueOperand();
+                if (!S->isSimple() || Stored->getType() != L->getType())
+                    return nullptr;
+                return Stored;
             }
+            if (!isDistinctObject(S->getPointerOperand(), Ptr))
+                return nullptr;
+            continue;
         }
-        return PreservedAnalyses::none();
+        if (I->mayWriteToMemory())
+            return nullptr;
+    }
+    return nullptr;
+}
+
+// Con MemorySSA lo store che definisce il valore letto da L puo' trovarsi
+// in un blocco dominante, oltre accessi in memoria che non lo sovrascrivono
+static Value *findForwardedStore(LoadInst *L, RewriteContext &Ctx) {
+    if (!L->isSimple())
+        return nullptr;
+    MemorySSA *MSSA = Ctx.getMemorySSA();
+    if (!MSSA)
+        return findForwardedStoreInBlock(L);
+
+    MemoryAccess *Clobber = MSSA->getWalker()->getClobberingMemoryAccess(L);
+    auto *Def = dyn_cast_or_null<MemoryDef>(Clobber);
+    if (!Def || MSSA->isLiveOnEntryDef(Def))
+        return nullptr;
+    auto *S = dyn_cast_or_null<StoreInst>(Def->getMemoryInst());
+    if (!S || !S->isSimple() || S->getValueOperand()->getType() != L->getType())
+        return nullptr;
+    if (Ctx.AA->alias(MemoryLocation::get(S), MemoryLocation::get(L)) != AliasResult::MustAlias)
+        return nullptr;
+    if (!Ctx.DT->dominates(S, L))
+        return nullptr;
+    return S->getValueOperand();
+}
+
+// Matcher nello stile di PatternMatch: applica SubPattern al valore oppure,
+// se il valore e' un load, al valore memorizzato dallo store che lo definisce
+template <typename SubPattern_t> struct Forwarded_match {
+    RewriteContext &Ctx;
+    SubPattern_t SubPattern;
+
+    Forwarded_match(RewriteContext &Ctx, const SubPattern_t &SP) : Ctx(Ctx), SubPattern(SP) {}
+
+    template <typename OpTy> bool match(OpTy *V) {
+        if (SubPattern.match(V))
+            return true;
+        if (auto *L = dyn_cast<LoadInst>(V))
+            if (Value *Stored = findForwardedStore(L, Ctx))
+                return SubPattern.match(Stored);
+        return false;
     }
 };
 
-// Terzo Pass: Multi-Instruction Optimization (ora supporta store/load)
+template <typename T> inline Forwarded_match<T> m_Forwarded(RewriteContext &Ctx, const T &SubPattern) {
+    return Forwarded_match<T>(Ctx, SubPattern);
+}
+
+// (b + c) - c -> b, (b + c) - b -> c, b - (b - c) -> c
+static Value *foldSubCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *LHS = I.getOperand(0), *RHS = I.getOperand(1), *B;
+    if (match(LHS, m_Forwarded(Ctx, m_c_Add(m_Value(B), m_Specific(RHS)))))
+        return B;
+    if (match(RHS, m_Forwarded(Ctx, m_Sub(m_Specific(LHS), m_Value(B)))))
+        return B;
+    return nullptr;
+}
+
+// (b - c) + c -> b
+static Value *foldAddCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *B;
+    for (unsigned Op = 0; Op != 2; ++Op)
+        if (match(I.getOperand(Op), m_Forwarded(Ctx, m_Sub(m_Value(B), m_Specific(I.getOperand(1 - Op))))))
+            return B;
+    return nullptr;
+}
+
+// (b ^ c) ^ c -> b
+static Value *foldXorCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *B;
+    for (unsigned Op = 0; Op != 2; ++Op)
+        if (match(I.getOperand(Op), m_Forwarded(Ctx, m_c_Xor(m_Value(B), m_Specific(I.getOperand(1 - Op))))))
+            return B;
+    return nullptr;
+}
+
+// (b * c) / c -> b se la mul non va in overflow (nsw per sdiv, nuw per udiv)
+static Value *foldDivCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *LHS = I.getOperand(0), *C = I.getOperand(1), *B;
+    if (I.getOpcode() == Instruction::SDiv &&
+        match(LHS, m_Forwarded(Ctx, m_CombineOr(m_NSWMul(m_Value(B), m_Specific(C)), m_NSWMul(m_Specific(C), m_Value(B))))))
+        return B;
+    if (I.getOpcode() == Instruction::UDiv &&
+        match(LHS, m_Forwarded(Ctx, m_CombineOr(m_NUWMul(m_Value(B), m_Specific(C)), m_NUWMul(m_Specific(C), m_Value(B))))))
+        return B;
+    return nullptr;
+}
+
+// (b /exact c) * c -> b
+static Value *foldMulCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *B;
+    for (unsigned Op = 0; Op != 2; ++Op) {
+        Value *C = I.getOperand(1 - Op);
+        if (match(I.getOperand(Op), m_Forwarded(Ctx, m_Exact(m_CombineOr(m_SDiv(m_Value(B), m_Specific(C)),
+                                                                    m_UDiv(m_Value(B), m_Specific(C)))))))
+            return B;
+    }
+    return nullptr;
+}
+
+// (b << c) >> c -> b se lo shl non perde bit (nuw per lshr, nsw per ashr)
+static Value *foldShiftCancel(Instruction &I, IRBuilderBase &, RewriteContext &Ctx) {
+    Value *LHS = I.getOperand(0), *C = I.getOperand(1), *B;
+    if (I.getOpcode() == Instruction::LShr && match(LHS, m_Forwarded(Ctx, m_NUWShl(m_Value(B), m_Specific(C)))))
+        return B;
+    if (I.getOpcode() == Instruction::AShr && match(LHS, m_Forwarded(Ctx, m_NSWShl(m_Value(B), m_Specific(C)))))
+        return B;
+    return nullptr;
+}
+
+STATISTIC(NumSubCancel, "sub annullate da un add/sub precedente");
+STATISTIC(NumAddCancel, "(b - c) + c semplificate");
+STATISTIC(NumXorCancel, "xor annullate da uno xor precedente");
+STATISTIC(NumDivCancel, "(b * c) / c semplificate");
+STATISTIC(NumMulCancel, "(b / c) * c esatte semplificate");
+STATISTIC(NumShiftCancel, "(b << c) >> c semplificate");
+
+static const RuleTable &getMultiInstructionRules() {
+    static const RuleTable Rules = RuleTable()
+        .add({Instruction::Sub}, foldSubCancel, "SubCancel", NumSubCancel)
+        .add({Instruction::Add}, foldAddCancel, "AddCancel", NumAddCancel)
+        .add({Instruction::Xor}, foldXorCancel, "XorCancel", NumXorCancel)
+        .add({Instruction::SDiv, Instruction::UDiv}, foldDivCancel, "DivCancel", NumDivCancel)
+        .add({Instruction::Mul}, foldMulCancel, "MulCancel", NumMulCancel)
+        .add({Instruction::LShr, Instruction::AShr}, foldShiftCancel, "ShiftCancel", NumShiftCancel);
+    return Rules;
+}
+
 struct MultiInstructionOptimizationPass : public PassInfoMixin<MultiInstructionOptimizationPass> {
-    PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
-        for (auto &BB : F) {
-            for (auto it = BB.begin(), end = BB.end(); it != end;) {
-                Instruction *I = &*it++;
-
-                // Trova l'istruzione di add (b + 1)
-                if (auto *addInst = dyn_cast<BinaryOperator>(I)) {
-                    if (addInst->getOpcode() == Instruction::Add) {
-                        Value *b = nullptr;
-                        if (auto *C = dyn_cast<ConstantInt>(addInst->getOperand(1))) {
-                            if (C->equalsInt(1)) b = addInst->getOperand(0);
-                        } else if (auto *C = dyn_cast<ConstantInt>(addInst->getOperand(0))) {
-                            if (C->equalsInt(1)) b = addInst->getOperand(1);
-                        }
-                        if (!b) continue;
-
-                        // Trova il successivo store di addInst
-                        if (it != end) {
-                            if (auto *store1 = dyn_cast<StoreInst>(&*it)) {
-                                if (store1->getValueOperand() == addInst) {
-                                    Value *allocaPtr = store1->getPointerOperand();
-
-                                    auto nextIt = std::next(it);
-                                    if (nextIt != end) {
-                                        if (auto *load = dyn_cast<LoadInst>(&*nextIt)) {
-                                            if (load->getPointerOperand() == allocaPtr) {
-                                                auto nextNextIt = std::next(nextIt);
-                                                if (nextNextIt != end) {
-                                                    if (auto *subInst = dyn_cast<BinaryOperator>(&*nextNextIt)) {
-                                                        if (subInst->getOpcode() == Instruction::Sub) {
-                                                            if (subInst->getOperand(0) == load) {
-                                                                if (auto *C2 = dyn_cast<ConstantInt>(subInst->getOperand(1))) {
-                                                                    if (C2->equalsInt(1)) {
-                                                                        subInst->setOperand(0, b);
-                                                                    }
-                                                                }
-                                                            }
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        return runRules(F, AM, name(), getMultiInstructionRules());
+    }
+};
+
+// Pass combinato: le regole dei pass in un'unica visita della funzione.
+// La riassociazione e le identita' precedono la strength reduction, cosi'
+// che mul x, 1 sparisca invece di essere espansa.
+static const RuleTable &getPeepholeRules() {
+    static const RuleTable Rules = RuleTable()
+        .add(getReassociationRules())
+        .add(getAlgebraicIdentityRules())
+        .add(getMultiInstructionRules())
+        .add(getStrengthReductionRules());
+    return Rules;
+}
+
+struct PeepholePass : public PassInfoMixin<PeepholePass> {
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        return runRules(F, AM, name(), getPeepholeRules());
+    }
+};
+
+// Le regole del pass combinato su tutte le funzioni del modulo, distribuite
+// su un ThreadPool. TTI, DominatorTree e BFI vengono calcolate prima in modo
+// seriale; senza analysis manager l'inoltro store/load resta limitato al
+// singolo blocco.
+struct ParallelPeepholePass : public PassInfoMixin<ParallelPeepholePass> {
+    unsigned NumThreads;
+
+    explicit ParallelPeepholePass(unsigned NumThreads) : NumThreads(NumThreads) {}
+
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
+        FunctionAnalysisManager &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        ProfileSummaryInfo *PSI = MAM.getCachedResult<ProfileSummaryAnalysis>(M);
+        bool HasProfile = PSI && PSI->hasProfileSummary();
+        struct Job {
+            Function *F;
+            const TargetTransformInfo *TTI;
+            DominatorTree *DT;
+            BlockFrequencyInfo *BFI;
+            size_t Size;
+            const OpcodeSummary *Summary;
+            Optional<uint64_t> CacheKey;
+            bool Changed;
+        };
+        SmallVector<Job, 0> Jobs;
+        for (Function &F : M) {
+            if (F.isDeclaration())
+                continue;
+            const OpcodeSummary &Summary = FAM.getResult<OpcodeSummaryAnalysis>(F);
+            if (!Summary.hasAnyOf(getPeepholeRules().opcodes()))
+                continue;
+            // Senza analysis manager LVI non e' mai disponibile
+            Optional<uint64_t> CacheKey = getRewriteCacheKey(F, name(), getRewriteCacheConfig(HasProfile, false));
+            if (CacheKey && RewriteCache::get().isUnchanged(*CacheKey))
+                continue;
+            Jobs.push_back({&F, &FAM.getResult<TargetIRAnalysis>(F), &FAM.getResult<DominatorTreeAnalysis>(F),
+                            HasProfile ? &FAM.getResult<BlockFrequencyAnalysis>(F) : nullptr,
+                            F.getInstructionCount(), &Summary, CacheKey, false});
+        }
+        if (Jobs.empty())
+            return PreservedAnalyses::all();
+        // Le funzioni piu' grandi per prime bilanciano meglio il carico
+        llvm::stable_sort(Jobs, [](const Job &A, const Job &B) { return A.Size > B.Size; });
+
+        std::mutex IRLock;
+        std::atomic<size_t> Next(0);
+        ThreadPool Pool(hardware_concurrency(NumThreads));
+        for (unsigned T = 0, E = std::min<size_t>(Pool.getThreadCount(), Jobs.size()); T != E; ++T) {
+            Pool.async([&] {
+                for (size_t Idx; (Idx = Next++) < Jobs.size();) {
+                    Job &J = Jobs[Idx];
+                    RewriteContext Ctx(*J.F, *J.TTI, *J.DT, PSI, J.BFI, IRLock);
+                    J.Changed = runToFixpoint(*J.F, getPeepholeRules(), Ctx, J.Summary);
+                }
+            });
+        }
+        Pool.wait();
+
+        bool Changed = false;
+        for (const Job &J : Jobs) {
+            if (J.Changed) {
+                FAM.invalidate(*J.F, getPreservedAnalyses(true));
+                Changed = true;
+            } else if (J.CacheKey) {
+                RewriteCache::get().recordUnchanged(*J.CacheKey);
+            }
+        }
+        if (!Changed)
+            return PreservedAnalyses::all();
+        // Le analisi delle funzioni modificate sono gia' state invalidate
+        PreservedAnalyses PA;
+        PA.preserveSet<AllAnalysesOn<Function>>();
+        PA.preserve<FunctionAnalysisManagerModuleProxy>();
+        PA.preserveSet<CFGAnalyses>();
+        return PA;
+    }
+};
+
+STATISTIC(NumIVRecurrences, "espressioni affini nell'IV sostituite da una ricorrenza");
+
+// Quarto Pass: strength reduction delle variabili di induzione
+// Un'espressione affine nell'IV che contiene una mul, {Start,+,Step}<L>
+// secondo SCEV, diventa una nuova PHI nell'header incrementata di Step al
+// latch. Start e Step sono invarianti e vengono espansi nel preheader.
+struct InductionStrengthReductionPass : public PassInfoMixin<InductionStrengthReductionPass> {
+    PreservedAnalyses run(Loop &L, LoopAnalysisManager &, LoopStandardAnalysisResults &AR, LPMUpdater &) {
+        BasicBlock *Preheader = L.getLoopPreheader();
+        BasicBlock *Latch = L.getLoopLatch();
+        if (!Preheader || !Latch)
+            return PreservedAnalyses::all();
+
+        ScalarEvolution &SE = AR.SE;
+        auto getAffineAddRec = [&](Value *V) -> const SCEVAddRecExpr * {
+            if (!V->getType()->isIntegerTy() || !SE.isSCEVable(V->getType()))
+                return nullptr;
+            auto *AddRec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(V));
+            if (!AddRec || AddRec->getLoop() != &L || !AddRec->isAffine())
+                return nullptr;
+            return AddRec;
+        };
+
+        // Radici da sostituire: per ogni mul si risale finche' l'unico
+        // utente resta un'espressione affine nello stesso loop
+        // (WeakVH: una radice puo' morire eliminando la catena di un'altra)
+        SmallVector<WeakVH, 8> Roots;
+        for (BasicBlock *BB : L.blocks()) {
+            for (Instruction &I : *BB) {
+                if (I.getOpcode() != Instruction::Mul || !getAffineAddRec(&I))
+                    continue;
+                Instruction *Root = &I;
+                while (Root->hasOneUse()) {
+                    auto *U = cast<Instruction>(Root->user_back());
+                    if (!L.contains(U) || isa<PHINode>(U) || !getAffineAddRec(U))
+                        break;
+                    Root = U;
                 }
+                if (!is_contained(Roots, Root))
+                    Roots.emplace_back(Root);
             }
         }
-        return PreservedAnalyses::none();
+        if (Roots.empty())
+            return PreservedAnalyses::all();
+
+        // Le PHI gia' presenti nell'header coprono le ricorrenze uguali; una
+        // ricorrenza con lo stesso passo e partenza a distanza costante si
+        // ottiene con una add invece che con una nuova PHI
+        DenseMap<const SCEV *, Value *> Recurrences;
+        DenseMap<const SCEV *, PHINode *> RecurrenceByStep;
+        for (PHINode &PN : L.getHeader()->phis()) {
+            if (auto *AddRec = getAffineAddRec(&PN)) {
+                Recurrences.try_emplace(AddRec, &PN);
+                RecurrenceByStep.try_emplace(AddRec->getStepRecurrence(SE), &PN);
+            }
+        }
+
+        const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+        SCEVExpander Expander(SE, DL, "iv.sr");
+        OptimizationRemarkEmitter ORE(L.getHeader()->getParent());
+        Instruction *PreheaderTerm = Preheader->getTerminator();
+        bool Changed = false;
+        for (WeakVH &VH : Roots) {
+            auto *Root = cast_or_null<Instruction>(VH);
+            const SCEVAddRecExpr *AddRec = Root ? getAffineAddRec(Root) : nullptr;
+            if (!AddRec)
+                continue;
+            Value *&Recurrence = Recurrences[AddRec];
+            const SCEV *Start = AddRec->getStart();
+            const SCEV *Step = AddRec->getStepRecurrence(SE);
+            PHINode *&SameStep = RecurrenceByStep[Step];
+            if (!Recurrence && SameStep && SameStep->getType() == Root->getType()) {
+                const SCEV *Offset = SE.getMinusSCEV(Start, cast<SCEVAddRecExpr>(SE.getSCEV(SameStep))->getStart());
+                if (auto *C = dyn_cast<SCEVConstant>(Offset))
+                    Recurrence = BinaryOperator::CreateAdd(SameStep, C->getValue(), "iv.sr.off",
+                                                           &*L.getHeader()->getFirstInsertionPt());
+            }
+            if (!Recurrence) {
+                if (!isSafeToExpandAt(Start, PreheaderTerm, SE) || !isSafeToExpandAt(Step, PreheaderTerm, SE))
+                    continue;
+                Type *Ty = Root->getType();
+                Value *StartV = Expander.expandCodeFor(Start, Ty, PreheaderTerm);
+                Value *StepV = Expander.expandCodeFor(Step, Ty, PreheaderTerm);
+                PHINode *PN = PHINode::Create(Ty, 2, "iv.sr", &L.getHeader()->front());
+                Value *Next = BinaryOperator::CreateAdd(PN, StepV, "iv.sr.next", Latch->getTerminator());
+                for (BasicBlock *Pred : predecessors(L.getHeader()))
+                    PN->addIncoming(Pred == Preheader ? StartV : Next, Pred);
+                Recurrence = PN;
+                if (!SameStep)
+                    SameStep = PN;
+            }
+            ORE.emit([&]() {
+                std::string Rec;
+                raw_string_ostream(Rec) << *AddRec;
+                return OptimizationRemark(DEBUG_TYPE, "IVRecurrence", Root)
+                       << ore::NV("Opcode", Root->getOpcodeName()) << " rewritten as recurrence "
+                       << ore::NV("Recurrence", Rec);
+            });
+            ++NumIVRecurrences;
+            SE.forgetValue(Root);
+            Root->replaceAllUsesWith(Recurrence);
+            RecursivelyDeleteTriviallyDeadInstructions(Root);
+            Changed = true;
+        }
+        if (!Changed)
+            return PreservedAnalyses::all();
+        return getLoopPassPreservedAnalyses();
     }
 };
 
 } // end anonymous namespace
 
 // Parte per registrare i pass nel plugin
-extern "C" ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+// Con il plugin caricato da clang (-fpass-plugin) o da opt con una pipeline
+// default<On> i pass entrano da soli nei punti di estensione. Linkato dentro
+// i tool l'inserimento va chiesto esplicitamente.
+static cl::opt<bool> RegisterInDefaultPipelines(
+    "testpass-default-pipelines",
+#ifdef LLVM_TESTPASS_LINK_INTO_TOOLS
+    cl::init(false),
+#else
+    cl::init(true),
+#endif
+    cl::desc("Inserisce i pass del plugin nelle pipeline default<O1/O2/O3>"));
+
+// InstCombine ricompone shl+sub in una mul, quindi prima dell'ultima
+// InstCombine girano solo le regole che non vengono disfatte: riassociazione
+// dopo ogni InstCombine e inoltro store/load a fine semplificazione. La
+// strength reduction va in coda all'ottimizzazione, dopo i vettorizzatori e
+// le loro costanti splat.
+static void registerDefaultPipelineCallbacks(PassBuilder &PB) {
+    PB.registerPeepholeEPCallback([](FunctionPassManager &FPM, OptimizationLevel Level) {
+        if (RegisterInDefaultPipelines && Level != OptimizationLevel::O0)
+            FPM.addPass(ConstantReassociationPass());
+    });
+    PB.registerScalarOptimizerLateEPCallback([](FunctionPassManager &FPM, OptimizationLevel Level) {
+        if (RegisterInDefaultPipelines && Level.getSpeedupLevel() >= 2)
+            FPM.addPass(MultiInstructionOptimizationPass());
+    });
+    PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, OptimizationLevel Level) {
+        if (RegisterInDefaultPipelines && Level.getSpeedupLevel() >= 2)
+            MPM.addPass(createModuleToFunctionPassAdaptor(PeepholePass()));
+    });
+}
+
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
     return {LLVM_PLUGIN_API_VERSION, "TestPass", LLVM_VERSION_STRING,
             [](PassBuilder &PB) {
+                registerDefaultPipelineCallbacks(PB);
+                PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM) {
+                    FAM.registerPass([] { return OpcodeSummaryAnalysis(); });
+                });
                 PB.registerPipelineParsingCallback(
                     [](StringRef Name, FunctionPassManager &FPM,
                        ArrayRef<PassBuilder::PipelineElement>) {
@@ -167,15 +3388,61 @@ extern "C" ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
                             FPM.addPass(AlgebraicIdentityPass());
                             return true;
                         }
-                        if (Name == "strength-reduction") {
-                            FPM.addPass(StrengthReductionPass());
+                        // strength-reduction oppure strength-reduction<parametri>
+                        if (Name.consume_front("strength-reduction")) {
+                            if (!Name.empty() && (!Name.consume_front("<") || !Name.consume_back(">")))
+                                return false;
+                            Expected<StrengthReductionOptions> Options = parseStrengthReductionOptions(Name);
+                            if (!Options) {
+                                errs() << "testpass: " << toString(Options.takeError()) << '\n';
+                                return false;
+                            }
+                            FPM.addPass(StrengthReductionPass(*Options));
                             return true;
                         }
                         if (Name == "multi-instruction") {
                             FPM.addPass(MultiInstructionOptimizationPass());
                             return true;
                         }
+                        if (Name == "reassociate-constants") {
+                            FPM.addPass(ConstantReassociationPass());
+                            return true;
+                        }
+                        if (Name == "testpass-peephole") {
+                            FPM.addPass(PeepholePass());
+                            return true;
+                        }
+                        return false;
+                    });
+                PB.registerPipelineParsingCallback(
+                    [](StringRef Name, ModulePassManager &MPM,
+                       ArrayRef<PassBuilder::PipelineElement>) {
+                        // testpass-parallel<N>; senza N un thread per core
+                        if (!Name.consume_front("testpass-parallel"))
+                            return false;
+                        unsigned NumThreads = 0;
+                        if (!Name.empty() &&
+                            (!Name.consume_front("<") || !Name.consume_back(">") || Name.getAsInteger(10, NumThreads)))
+                            return false;
+                        MPM.addPass(ParallelPeepholePass(NumThreads));
+                        return true;
+                    });
+                PB.registerPipelineParsingCallback(
+                    [](StringRef Name, LoopPassManager &LPM,
+                       ArrayRef<PassBuilder::PipelineElement>) {
+                        if (Name == "iv-strength-reduction") {
+                            LPM.addPass(InductionStrengthReductionPass());
+                            return true;
+                        }
                         return false;
                     });
             }};
-}
\ No newline at end of file
+}
+
+// Con LLVM_TESTPASS_LINK_INTO_TOOLS i tool chiamano direttamente
+// getTestPassPluginInfo(), il punto d'ingresso dinamico non serve
+#ifndef LLVM_TESTPASS_LINK_INTO_TOOLS
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return getTestPassPluginInfo();
+}
+#endif
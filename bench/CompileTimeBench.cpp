@@ -0,0 +1,308 @@
+// Benchmark del tempo di compilazione dei pass del plugin.
+//
+// Genera moduli sintetici con un numero controllabile di istruzioni e una
+// densita' controllabile di pattern riconosciuti dai pass, oppure carica
+// moduli reali (.ll/.bc), e misura per ogni pipeline ns/istruzione, picco di
+// memoria e riscritture al secondo.
+//
+// L'ultima pipeline predefinita esegue uno dopo l'altro gli stessi pass che
+// testpass-peephole combina: il pass combinato deve restare al piu' alla pari
+// e di norma sotto, perche' visita ogni istruzione e invalida le analisi una
+// volta sola. Una pipeline di piu' pass si misura solo con la lista
+// predefinita, perche' -pipelines separa i valori alle virgole.
+//
+//   testpass-compile-bench -sizes=10000,1000000 -density=0.2
+//   testpass-compile-bench corpus/*.bc -pipelines=testpass-peephole -json
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <sys/resource.h>
+
+using namespace llvm;
+
+#ifndef TESTPASS_PLUGIN_PATH
+#define TESTPASS_PLUGIN_PATH "TestPass.so"
+#endif
+
+static cl::list<std::string> InputFiles(cl::Positional, cl::desc("[moduli .ll/.bc]"));
+
+static cl::opt<std::string> PluginPath("plugin", cl::init(TESTPASS_PLUGIN_PATH),
+                                       cl::desc("Percorso di TestPass.so"));
+
+static cl::list<unsigned> Sizes("sizes", cl::CommaSeparated,
+                                cl::desc("Istruzioni dei moduli sintetici (default 10^4,10^5,10^6)"));
+
+static cl::opt<double> Density("density", cl::init(0.1),
+                               cl::desc("Frazione di istruzioni che formano un pattern riconosciuto"));
+
+static cl::opt<unsigned> FunctionSize("function-size", cl::init(2000),
+                                      cl::desc("Istruzioni per funzione nei moduli sintetici"));
+
+static cl::list<std::string> Pipelines("pipelines", cl::CommaSeparated,
+                                       cl::desc("Pipeline da misurare (default: ogni pass e la pipeline completa)"));
+
+static cl::opt<unsigned> Repetitions("repetitions", cl::init(3),
+                                     cl::desc("Esecuzioni per misura, si tiene la piu' veloce"));
+
+static cl::opt<unsigned> Seed("seed", cl::init(1), cl::desc("Seme del generatore"));
+
+static cl::opt<bool> EmitJSON("json", cl::desc("Stampa i risultati in JSON"));
+
+namespace {
+
+// Genera una funzione "i32 f(i32, i32, i32)" con NumInsts istruzioni aritmetiche
+// legate tra loro; con probabilita' Density l'istruzione e' uno dei pattern dei pass
+void buildSyntheticFunction(Module &M, unsigned Index, unsigned NumInsts, std::mt19937 &Rng) {
+    LLVMContext &Ctx = M.getContext();
+    Type *I32 = Type::getInt32Ty(Ctx);
+    auto *FTy = FunctionType::get(I32, {I32, I32, I32}, false);
+    Function *F = Function::Create(FTy, Function::ExternalLinkage, "f" + Twine(Index), M);
+    IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+    Value *Slot = B.CreateAlloca(I32);
+
+    SmallVector<Value *, 64> Pool;
+    for (Argument &A : F->args())
+        Pool.push_back(&A);
+    std::uniform_real_distribution<double> Coin(0.0, 1.0);
+    auto pick = [&]() { return Pool[std::uniform_int_distribution<size_t>(0, Pool.size() - 1)(Rng)]; };
+    static const int64_t MulConstants[] = {2, 9, 10, 15, 24, 100, 1000, -7};
+    static const int64_t DivConstants[] = {3, 7, 8, 10, 64, 1000};
+
+    for (unsigned N = 0; N < NumInsts;) {
+        Value *X = pick(), *Y = pick(), *V = nullptr;
+        if (Coin(Rng) < Density) {
+            switch (std::uniform_int_distribution<unsigned>(0, 6)(Rng)) {
+            case 0:
+                V = B.CreateAdd(X, B.getInt32(0));
+                break;
+            case 1:
+                V = B.CreateMul(X, B.getInt32(1));
+                break;
+            case 2:
+                V = B.CreateMul(X, B.getInt32(MulConstants[Rng() % array_lengthof(MulConstants)]));
+                break;
+            case 3:
+                V = B.CreateSDiv(X, B.getInt32(DivConstants[Rng() % array_lengthof(DivConstants)]));
+                break;
+            case 4:
+                V = B.CreateURem(X, B.getInt32(DivConstants[Rng() % array_lengthof(DivConstants)]));
+                break;
+            case 5:
+                V = B.CreateXor(B.CreateXor(X, Y), Y);
+                ++N;
+                break;
+            default:
+                // Il giro add/store/load/sub riconosciuto da multi-instruction
+                B.CreateStore(B.CreateAdd(X, B.getInt32(1)), Slot);
+                V = B.CreateSub(B.CreateLoad(I32, Slot), B.getInt32(1));
+                N += 3;
+                break;
+            }
+        } else {
+            switch (std::uniform_int_distribution<unsigned>(0, 3)(Rng)) {
+            case 0:
+                V = B.CreateAdd(X, Y);
+                break;
+            case 1:
+                V = B.CreateXor(X, Y);
+                break;
+            case 2:
+                V = B.CreateMul(X, Y);
+                break;
+            default:
+                V = B.CreateSub(X, Y);
+                break;
+            }
+        }
+        ++N;
+        Pool.push_back(V);
+        if (Pool.size() > 64)
+            Pool.erase(Pool.begin() + 3);
+    }
+
+    // Tutti i valori confluiscono nel risultato, cosi' nulla e' codice morto
+    Value *Ret = Pool.back();
+    for (Value *V : Pool)
+        Ret = B.CreateXor(Ret, V);
+    B.CreateRet(Ret);
+}
+
+std::unique_ptr<Module> buildSyntheticModule(LLVMContext &Ctx, unsigned NumInsts) {
+    auto M = std::make_unique<Module>("synthetic-" + utostr(NumInsts), Ctx);
+    std::mt19937 Rng(Seed);
+    for (unsigned Done = 0, Index = 0; Done < NumInsts; Done += FunctionSize, ++Index)
+        buildSyntheticFunction(*M, Index, std::min<unsigned>(FunctionSize, NumInsts - Done), Rng);
+    return M;
+}
+
+size_t getPeakRSS() {
+    struct rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+    return size_t(Usage.ru_maxrss) * 1024;
+}
+
+struct Measurement {
+    std::string Module;
+    std::string Pipeline;
+    size_t Instructions = 0;
+    size_t Rewrites = 0;
+    double Seconds = 0;
+    size_t PeakRSS = 0;
+    size_t MallocDelta = 0;
+};
+
+// Esegue Pipeline su una copia di M; le istruzioni originali eliminate sono
+// le riscritture effettuate
+Expected<Measurement> runPipeline(const Module &M, StringRef Pipeline, PassPlugin &Plugin) {
+    Measurement Best;
+    for (unsigned Rep = 0; Rep < Repetitions; ++Rep) {
+        std::unique_ptr<Module> Clone = CloneModule(M);
+
+        SmallVector<WeakVH, 0> Original;
+        for (Function &F : *Clone)
+            for (BasicBlock &BB : F)
+                for (Instruction &I : BB)
+                    Original.emplace_back(&I);
+
+        LoopAnalysisManager LAM;
+        FunctionAnalysisManager FAM;
+        CGSCCAnalysisManager CGAM;
+        ModuleAnalysisManager MAM;
+        PassBuilder PB;
+        Plugin.registerPassBuilderCallbacks(PB);
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        ModulePassManager MPM;
+        if (Error Err = PB.parsePassPipeline(MPM, Pipeline))
+            return Err;
+
+        size_t MallocBefore = sys::Process::GetMallocUsage();
+        auto Start = std::chrono::steady_clock::now();
+        MPM.run(*Clone, MAM);
+        auto End = std::chrono::steady_clock::now();
+        size_t MallocAfter = sys::Process::GetMallocUsage();
+
+        Measurement R;
+        R.Module = M.getModuleIdentifier();
+        R.Pipeline = Pipeline.str();
+        R.Instructions = Original.size();
+        R.Rewrites = count_if(Original, [](const WeakVH &VH) { return !VH; });
+        R.Seconds = std::chrono::duration<double>(End - Start).count();
+        R.PeakRSS = getPeakRSS();
+        R.MallocDelta = MallocAfter > MallocBefore ? MallocAfter - MallocBefore : 0;
+        if (Rep == 0 || R.Seconds < Best.Seconds)
+            Best = R;
+    }
+    return Best;
+}
+
+void printTable(ArrayRef<Measurement> Results) {
+    const char *Row = "{0,-24} {1,-78} {2,10} {3,9:f1} {4,10} {5,12:f0} {6,9:f1}\n";
+    outs() << formatv("{0,-24} {1,-78} {2,10} {3,9} {4,10} {5,12} {6,9}\n", "module", "pipeline", "insts",
+                      "ns/inst", "rewrites", "rewrites/s", "peak MB");
+    for (const Measurement &R : Results)
+        outs() << formatv(Row, R.Module, R.Pipeline, R.Instructions,
+                          R.Seconds * 1e9 / std::max<size_t>(R.Instructions, 1), R.Rewrites,
+                          R.Rewrites / std::max(R.Seconds, 1e-9), R.PeakRSS / (1024.0 * 1024.0));
+}
+
+void printJSON(ArrayRef<Measurement> Results) {
+    json::Array Array;
+    for (const Measurement &R : Results)
+        Array.push_back(json::Object{
+            {"module", R.Module},
+            {"pipeline", R.Pipeline},
+            {"instructions", int64_t(R.Instructions)},
+            {"seconds", R.Seconds},
+            {"ns_per_instruction", R.Seconds * 1e9 / std::max<size_t>(R.Instructions, 1)},
+            {"rewrites", int64_t(R.Rewrites)},
+            {"rewrites_per_second", R.Rewrites / std::max(R.Seconds, 1e-9)},
+            {"peak_rss_bytes", int64_t(R.PeakRSS)},
+            {"malloc_delta_bytes", int64_t(R.MallocDelta)},
+        });
+    outs() << formatv("{0:2}", json::Value(std::move(Array))) << "\n";
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv, "TestPass compile-time benchmark\n");
+
+    Expected<PassPlugin> Plugin = PassPlugin::Load(PluginPath);
+    if (!Plugin) {
+        errs() << "error: " << toString(Plugin.takeError()) << "\n";
+        return 1;
+    }
+
+    SmallVector<std::string, 8> PipelineList(Pipelines.begin(), Pipelines.end());
+    if (PipelineList.empty())
+        PipelineList = {"reassociate-constants", "algebraic-identity", "strength-reduction", "multi-instruction",
+                        "testpass-peephole", "reassociate-constants,algebraic-identity,multi-instruction,strength-reduction"};
+
+    // I moduli vengono creati uno alla volta e liberati dopo la misura, cosi'
+    // il picco di memoria non accumula quello dei moduli precedenti
+    SmallVector<std::function<std::unique_ptr<Module>(LLVMContext &)>, 8> Sources;
+    for (const std::string &File : InputFiles)
+        Sources.push_back([&File, &argv](LLVMContext &Ctx) {
+            SMDiagnostic Err;
+            std::unique_ptr<Module> M = parseIRFile(File, Err, Ctx);
+            if (!M)
+                Err.print(argv[0], errs());
+            return M;
+        });
+    if (Sources.empty()) {
+        SmallVector<unsigned, 4> SizeList(Sizes.begin(), Sizes.end());
+        if (SizeList.empty())
+            SizeList = {10000, 100000, 1000000};
+        for (unsigned N : SizeList)
+            Sources.push_back([N](LLVMContext &Ctx) { return buildSyntheticModule(Ctx, N); });
+    }
+
+    SmallVector<Measurement, 16> Results;
+    for (auto &Source : Sources) {
+        LLVMContext Ctx;
+        std::unique_ptr<Module> M = Source(Ctx);
+        if (!M)
+            return 1;
+        for (const std::string &Pipeline : PipelineList) {
+            Expected<Measurement> R = runPipeline(*M, Pipeline, *Plugin);
+            if (!R) {
+                errs() << "error: " << toString(R.takeError()) << "\n";
+                return 1;
+            }
+            Results.push_back(*R);
+        }
+    }
+
+    if (EmitJSON)
+        printJSON(Results);
+    else
+        printTable(Results);
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Benchmark del codice generato: esegue i micro-kernel di RuntimeKernels.ll,
+// compilati una volta per variante (default<O2> da solo oppure seguito da un
+// pass del plugin), e riporta cicli, istruzioni e IPC letti dai contatori
+// hardware. Dove perf_event_open non e' disponibile restano solo i tempi.
+//
+//   testpass-runtime-bench-strength-reduction [-n 65536] [-reps 200]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+enum { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS };
+#endif
+
+#ifndef TESTPASS_BENCH_VARIANT
+#define TESTPASS_BENCH_VARIANT "unknown"
+#endif
+
+extern "C" {
+int32_t kernel_mul15(int32_t *A, int64_t N);
+int32_t kernel_mul100(int32_t *A, int64_t N);
+int32_t kernel_horner9(int32_t *A, int64_t N);
+int32_t kernel_sdiv7(int32_t *A, int64_t N);
+int32_t kernel_sdiv8(int32_t *A, int64_t N);
+int32_t kernel_udivrem10(int32_t *A, int64_t N);
+int32_t kernel_hash_bucket(int32_t *Keys, int32_t *Counts, int64_t N);
+int32_t kernel_index_bits(int32_t *A, int64_t N);
+int32_t kernel_roundtrip(int32_t *A, int64_t N);
+}
+
+namespace {
+
+// Contatore hardware di un singolo evento; Fd < 0 se non disponibile
+struct PerfCounter {
+    int Fd = -1;
+
+    explicit PerfCounter(uint64_t Config) {
+#ifdef __linux__
+        perf_event_attr Attr;
+        memset(&Attr, 0, sizeof(Attr));
+        Attr.size = sizeof(Attr);
+        Attr.type = PERF_TYPE_HARDWARE;
+        Attr.config = Config;
+        Attr.disabled = 1;
+        Attr.exclude_kernel = 1;
+        Attr.exclude_hv = 1;
+        Fd = syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+#else
+        (void)Config;
+#endif
+    }
+
+    ~PerfCounter() {
+#ifdef __linux__
+        if (Fd >= 0)
+            close(Fd);
+#endif
+    }
+
+    bool available() const { return Fd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (Fd >= 0) {
+            ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t Value = 0;
+#ifdef __linux__
+        if (Fd >= 0) {
+            ioctl(Fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(Fd, &Value, sizeof(Value)) != sizeof(Value))
+                Value = 0;
+        }
+#endif
+        return Value;
+    }
+};
+
+struct Sample {
+    double Nanos;
+    uint64_t Cycles;
+    uint64_t Instructions;
+};
+
+struct Inputs {
+    std::vector<int32_t> Values;
+    std::vector<int32_t> Counts;
+};
+
+using KernelFn = int32_t (*)(Inputs &);
+
+struct Kernel {
+    const char *Name;
+    KernelFn Run;
+};
+
+const Kernel Kernels[] = {
+    {"mul15", [](Inputs &In) { return kernel_mul15(In.Values.data(), In.Values.size()); }},
+    {"mul100", [](Inputs &In) { return kernel_mul100(In.Values.data(), In.Values.size()); }},
+    {"horner9", [](Inputs &In) { return kernel_horner9(In.Values.data(), In.Values.size()); }},
+    {"sdiv7", [](Inputs &In) { return kernel_sdiv7(In.Values.data(), In.Values.size()); }},
+    {"sdiv8", [](Inputs &In) { return kernel_sdiv8(In.Values.data(), In.Values.size()); }},
+    {"udivrem10", [](Inputs &In) { return kernel_udivrem10(In.Values.data(), In.Values.size()); }},
+    {"hash-bucket", [](Inputs &In) {
+         std::fill(In.Counts.begin(), In.Counts.end(), 0);
+         return kernel_hash_bucket(In.Values.data(), In.Counts.data(), In.Values.size());
+     }},
+    {"index-bits", [](Inputs &In) { return kernel_index_bits(In.Values.data(), In.Values.size()); }},
+    {"roundtrip", [](Inputs &In) { return kernel_roundtrip(In.Values.data(), In.Values.size()); }},
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int64_t N = 1 << 16;
+    unsigned Reps = 200;
+    for (int I = 1; I + 1 < argc; I += 2) {
+        if (!strcmp(argv[I], "-n"))
+            N = std::max<int64_t>(1, atoll(argv[I + 1]));
+        else if (!strcmp(argv[I], "-reps"))
+            Reps = std::max(1, atoi(argv[I + 1]));
+    }
+
+    // Input fissi: il checksum deve coincidere tra le varianti
+    Inputs In;
+    In.Values.resize(N);
+    In.Counts.resize(1000);
+    std::mt19937 RNG(42);
+    for (int32_t &V : In.Values)
+        V = static_cast<int32_t>(RNG());
+
+    PerfCounter Cycles(PERF_COUNT_HW_CPU_CYCLES);
+    PerfCounter Instructions(PERF_COUNT_HW_INSTRUCTIONS);
+    if (!Cycles.available())
+        fprintf(stderr, "perf_event_open non disponibile: solo tempi\n");
+
+    printf("%-20s %-12s %12s %12s %14s %6s %10s\n", "variant", "kernel", "ns/elem",
+           "cycles/elem", "instrs/elem", "IPC", "checksum");
+    for (const Kernel &K : Kernels) {
+        int32_t Checksum = K.Run(In);
+        // Si tiene la ripetizione piu' veloce, come nel benchmark di compilazione
+        Sample Best = {1e300, 0, 0};
+        for (unsigned R = 0; R != Reps; ++R) {
+            auto Begin = std::chrono::steady_clock::now();
+            Cycles.start();
+            Instructions.start();
+            int32_t Result = K.Run(In);
+            uint64_t NumInstrs = Instructions.stop();
+            uint64_t NumCycles = Cycles.stop();
+            auto End = std::chrono::steady_clock::now();
+            if (Result != Checksum) {
+                fprintf(stderr, "%s: risultato non deterministico\n", K.Name);
+                return 1;
+            }
+            double Nanos = std::chrono::duration<double, std::nano>(End - Begin).count();
+            if (Nanos < Best.Nanos)
+                Best = {Nanos, NumCycles, NumInstrs};
+        }
+
+        double PerElem = static_cast<double>(N);
+        printf("%-20s %-12s %12.3f", TESTPASS_BENCH_VARIANT, K.Name, Best.Nanos / PerElem);
+        if (Cycles.available())
+            printf(" %12.3f %14.3f %6.2f", Best.Cycles / PerElem, Best.Instructions / PerElem,
+                   Best.Cycles ? double(Best.Instructions) / Best.Cycles : 0.0);
+        else
+            printf(" %12s %14s %6s", "-", "-", "-");
+        printf(" %10u\n", static_cast<unsigned>(Checksum));
+    }
+    return 0;
+}
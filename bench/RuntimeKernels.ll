@@ -0,0 +1,205 @@
+; Micro-kernel del benchmark di runtime. Ogni kernel isola uno dei pattern
+; riscritti dai pass del plugin; i totali vengono restituiti al driver, che li
+; stampa come checksum per confrontare le varianti.
+;
+; Tutti i kernel assumono n >= 1.
+
+; sum(a[i] * 15): mul per costante indipendente tra le iterazioni
+define i32 @kernel_mul15(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %m = mul i32 %v, 15
+  %acc.next = add i32 %acc, %m
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; sum(a[i] * 100): costante per cui la catena shift/add non batte la mul
+define i32 @kernel_mul100(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %m = mul i32 %v, 100
+  %acc.next = add i32 %acc, %m
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; acc = acc * 9 + a[i]: la mul e' sulla catena di dipendenze del loop, conta la latenza
+define i32 @kernel_horner9(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %m = mul i32 %acc, 9
+  %acc.next = add i32 %m, %v
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; acc = acc / 7 + a[i]: divisione con segno sulla catena di dipendenze
+define i32 @kernel_sdiv7(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %d = sdiv i32 %acc, 7
+  %acc.next = add i32 %d, %v
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; sum(a[i] / 8) con segno: il caso potenza di due con correzione del bias
+define i32 @kernel_sdiv8(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %d = sdiv i32 %v, 8
+  %acc.next = add i32 %acc, %d
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; sum(a[i] udiv 10 + a[i] urem 10): quoziente e resto senza segno
+define i32 @kernel_udivrem10(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %q = udiv i32 %v, 10
+  %r = urem i32 %v, 10
+  %s = add i32 %q, %r
+  %acc.next = add i32 %acc, %s
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; counts[(key * 2654435761) urem 1000]++: bucketing di una tabella hash
+define i32 @kernel_hash_bucket(i32* noalias %keys, i32* noalias %counts, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %keys, i64 %i
+  %k = load i32, i32* %p
+  %h = mul i32 %k, -1640531535
+  %b = urem i32 %h, 1000
+  %b.ext = zext i32 %b to i64
+  %c = getelementptr inbounds i32, i32* %counts, i64 %b.ext
+  %old = load i32, i32* %c
+  %new = add i32 %old, 1
+  store i32 %new, i32* %c
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %first = load i32, i32* %counts
+  ret i32 %first
+}
+
+; sum((a[i] / 8) * 8 + (a[i] / 16 < 4)): arrotondamento e confronto di un
+; quoziente senza segno, tipici del calcolo di indici. InstCombine li
+; riconosce gia' dentro default<O2>: qui le varianti devono coincidere
+define i32 @kernel_index_bits(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %q8 = udiv i32 %v, 8
+  %r = mul i32 %q8, 8
+  %q16 = udiv i32 %v, 16
+  %small = icmp ult i32 %q16, 4
+  %z = zext i1 %small to i32
+  %s = add i32 %r, %z
+  %acc.next = add i32 %acc, %s
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+@sink = global i32 0
+
+; Il giro b + 1 / store / load / - 1 riconosciuto da multi-instruction. GVN lo
+; risolve gia' dentro default<O2>: fa da controllo, le varianti devono coincidere
+define i32 @kernel_roundtrip(i32* noalias %a, i64 %n) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %b = load i32, i32* %p
+  %t = add i32 %b, 1
+  store i32 %t, i32* @sink
+  %l = load i32, i32* @sink
+  %r = sub i32 %l, 1
+  %acc.next = add i32 %acc, %r
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
@@ -0,0 +1,50 @@
+; Driver per i moduli di llvm-stress: chiama @autogen con buffer inizializzati
+; in modo deterministico e ne stampa il contenuto
+
+@b8 = global [16 x i8] zeroinitializer
+@b32 = global [16 x i32] zeroinitializer
+@b64 = global [16 x i64] zeroinitializer
+@fmt = private constant [19 x i8] c"%02x %08x %016llx\0A\00"
+
+declare void @autogen(i8*, i32*, i64*, i32, i64, i8)
+declare i32 @printf(i8*, ...)
+
+define i32 @main() {
+entry:
+  br label %init
+init:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %init ]
+  %p8 = getelementptr [16 x i8], [16 x i8]* @b8, i64 0, i64 %i
+  %p32 = getelementptr [16 x i32], [16 x i32]* @b32, i64 0, i64 %i
+  %p64 = getelementptr [16 x i64], [16 x i64]* @b64, i64 0, i64 %i
+  %k = mul i64 %i, 2654435761
+  %k8 = trunc i64 %k to i8
+  %k32 = trunc i64 %k to i32
+  store i8 %k8, i8* %p8
+  store i32 %k32, i32* %p32
+  store i64 %k, i64* %p64
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, 16
+  br i1 %done, label %call, label %init
+call:
+  %a8 = getelementptr [16 x i8], [16 x i8]* @b8, i64 0, i64 0
+  %a32 = getelementptr [16 x i32], [16 x i32]* @b32, i64 0, i64 0
+  %a64 = getelementptr [16 x i64], [16 x i64]* @b64, i64 0, i64 0
+  call void @autogen(i8* %a8, i32* %a32, i64* %a64, i32 -7, i64 123456789, i8 5)
+  br label %print
+print:
+  %j = phi i64 [ 0, %call ], [ %j.next, %print ]
+  %q8 = getelementptr [16 x i8], [16 x i8]* @b8, i64 0, i64 %j
+  %q32 = getelementptr [16 x i32], [16 x i32]* @b32, i64 0, i64 %j
+  %q64 = getelementptr [16 x i64], [16 x i64]* @b64, i64 0, i64 %j
+  %v8 = load i8, i8* %q8
+  %v32 = load i32, i32* %q32
+  %v64 = load i64, i64* %q64
+  %f = getelementptr [19 x i8], [19 x i8]* @fmt, i64 0, i64 0
+  call i32 (i8*, ...) @printf(i8* %f, i8 %v8, i32 %v32, i64 %v64)
+  %j.next = add i64 %j, 1
+  %end = icmp eq i64 %j.next, 16
+  br i1 %end, label %exit, label %print
+exit:
+  ret i32 0
+}
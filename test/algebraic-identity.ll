@@ -0,0 +1,194 @@
+; Identita' algebriche: operandi neutri e assorbenti, x op x, shift di 0 e
+; div per 1, anche sui vettori. Sui float x + 0.0 e x - -0.0 richiedono nsz
+; (-0.0 + 0.0 = 0.0) e x * 0.0 anche nnan e ninf
+; RUN: opt %loadtestpass -passes=algebraic-identity -S %s | FileCheck %s
+
+define i32 @add0(i32 %x) {
+; CHECK-LABEL: @add0(
+; CHECK-NEXT:    ret i32 %x
+  %r = add i32 0, %x
+  ret i32 %r
+}
+
+define i32 @sub0(i32 %x) {
+; CHECK-LABEL: @sub0(
+; CHECK-NEXT:    ret i32 %x
+  %r = sub i32 %x, 0
+  ret i32 %r
+}
+
+define i32 @subself(i32 %x) {
+; CHECK-LABEL: @subself(
+; CHECK-NEXT:    ret i32 0
+  %r = sub i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @zerosub(i32 %x) {
+; CHECK-LABEL: @zerosub(
+; CHECK-NEXT:    %r = sub i32 0, %x
+; CHECK-NEXT:    ret i32 %r
+  %r = sub i32 0, %x
+  ret i32 %r
+}
+
+define i32 @mul1(i32 %x) {
+; CHECK-LABEL: @mul1(
+; CHECK-NEXT:    ret i32 %x
+  %r = mul i32 1, %x
+  ret i32 %r
+}
+
+define i32 @mul0(i32 %x) {
+; CHECK-LABEL: @mul0(
+; CHECK-NEXT:    ret i32 0
+  %r = mul i32 %x, 0
+  ret i32 %r
+}
+
+define i32 @andones(i32 %x) {
+; CHECK-LABEL: @andones(
+; CHECK-NEXT:    ret i32 %x
+  %r = and i32 %x, -1
+  ret i32 %r
+}
+
+define i32 @and0(i32 %x) {
+; CHECK-LABEL: @and0(
+; CHECK-NEXT:    ret i32 0
+  %r = and i32 %x, 0
+  ret i32 %r
+}
+
+define i32 @andself(i32 %x) {
+; CHECK-LABEL: @andself(
+; CHECK-NEXT:    ret i32 %x
+  %r = and i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @or0(i32 %x) {
+; CHECK-LABEL: @or0(
+; CHECK-NEXT:    ret i32 %x
+  %r = or i32 %x, 0
+  ret i32 %r
+}
+
+define i32 @orones(i32 %x) {
+; CHECK-LABEL: @orones(
+; CHECK-NEXT:    ret i32 -1
+  %r = or i32 %x, -1
+  ret i32 %r
+}
+
+define i32 @orself(i32 %x) {
+; CHECK-LABEL: @orself(
+; CHECK-NEXT:    ret i32 %x
+  %r = or i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @xor0(i32 %x) {
+; CHECK-LABEL: @xor0(
+; CHECK-NEXT:    ret i32 %x
+  %r = xor i32 %x, 0
+  ret i32 %r
+}
+
+define i32 @xorself(i32 %x) {
+; CHECK-LABEL: @xorself(
+; CHECK-NEXT:    ret i32 0
+  %r = xor i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @shifts0(i32 %x) {
+; CHECK-LABEL: @shifts0(
+; CHECK-NEXT:    ret i32 %x
+  %a = shl i32 %x, 0
+  %b = lshr i32 %a, 0
+  %r = ashr i32 %b, 0
+  ret i32 %r
+}
+
+define i32 @div1(i32 %x) {
+; CHECK-LABEL: @div1(
+; CHECK-NEXT:    ret i32 %x
+  %a = udiv i32 %x, 1
+  %r = sdiv i32 %a, 1
+  ret i32 %r
+}
+
+define <2 x i32> @vec(<2 x i32> %x) {
+; CHECK-LABEL: @vec(
+; CHECK-NEXT:    ret <2 x i32> %x
+  %a = add <2 x i32> %x, zeroinitializer
+  %r = mul <2 x i32> %a, <i32 1, i32 1>
+  ret <2 x i32> %r
+}
+
+define float @fadd_negzero(float %x) {
+; CHECK-LABEL: @fadd_negzero(
+; CHECK-NEXT:    ret float %x
+  %r = fadd float %x, -0.0
+  ret float %r
+}
+
+define float @fadd_poszero(float %x) {
+; CHECK-LABEL: @fadd_poszero(
+; CHECK-NEXT:    %r = fadd float %x, 0.000000e+00
+; CHECK-NEXT:    ret float %r
+  %r = fadd float %x, 0.0
+  ret float %r
+}
+
+define float @fadd_poszero_nsz(float %x) {
+; CHECK-LABEL: @fadd_poszero_nsz(
+; CHECK-NEXT:    ret float %x
+  %r = fadd nsz float %x, 0.0
+  ret float %r
+}
+
+define float @fsub_poszero(float %x) {
+; CHECK-LABEL: @fsub_poszero(
+; CHECK-NEXT:    ret float %x
+  %r = fsub float %x, 0.0
+  ret float %r
+}
+
+define float @fsub_negzero(float %x) {
+; CHECK-LABEL: @fsub_negzero(
+; CHECK-NEXT:    %r = fsub float %x, -0.000000e+00
+; CHECK-NEXT:    ret float %r
+  %r = fsub float %x, -0.0
+  ret float %r
+}
+
+define float @fmul1(float %x) {
+; CHECK-LABEL: @fmul1(
+; CHECK-NEXT:    ret float %x
+  %r = fmul float 1.0, %x
+  ret float %r
+}
+
+define float @fmul0(float %x) {
+; CHECK-LABEL: @fmul0(
+; CHECK-NEXT:    %r = fmul float %x, 0.000000e+00
+; CHECK-NEXT:    ret float %r
+  %r = fmul float %x, 0.0
+  ret float %r
+}
+
+define float @fmul0_fast(float %x) {
+; CHECK-LABEL: @fmul0_fast(
+; CHECK-NEXT:    ret float 0.000000e+00
+  %r = fmul nnan ninf nsz float %x, 0.0
+  ret float %r
+}
+
+define float @fdiv1(float %x) {
+; CHECK-LABEL: @fdiv1(
+; CHECK-NEXT:    ret float %x
+  %r = fdiv float %x, 1.0
+  ret float %r
+}
@@ -0,0 +1,41 @@
+; Con -testpass-alive2-dir ogni riscrittura finisce in un file con la coppia
+; @src/@tgt, le foglie dell'espressione come argomenti
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: opt %loadtestpass -passes=testpass-peephole -testpass-alive2-dir=%t -disable-output %s
+; RUN: FileCheck %s --check-prefix=MUL < %t/mul9-MulReduced-0.ll
+; RUN: FileCheck %s --check-prefix=DIV < %t/udiv8-DivRemReduced-1.ll
+; RUN: FileCheck %s --check-prefix=ADD < %t/addzero-AddIdentity-2.ll
+
+; MUL-LABEL: define i32 @src(i32 %0)
+; MUL-NEXT:  entry:
+; MUL-NEXT:    %m = mul i32 %0, 9
+; MUL-NEXT:    ret i32 %m
+; MUL-LABEL: define i32 @tgt(i32 %0)
+; MUL:         %shift = shl i32 %0, 3
+; MUL-NEXT:    %add = add i32 %0, %shift
+; MUL-NEXT:    ret i32 %add
+
+; DIV-LABEL: define i32 @src(i32 %0)
+; DIV:         %d = udiv i32 %0, 8
+; DIV-LABEL: define i32 @tgt(i32 %0)
+; DIV:         %lshr = lshr i32 %0, 3
+; DIV-NEXT:    ret i32 %lshr
+
+; ADD-LABEL: define i32 @tgt(i32 %0)
+; ADD-NEXT:  entry:
+; ADD-NEXT:    ret i32 %0
+
+define i32 @mul9(i32 %x) {
+  %m = mul i32 %x, 9
+  ret i32 %m
+}
+
+define i32 @udiv8(i32 %x) {
+  %d = udiv i32 %x, 8
+  ret i32 %d
+}
+
+define i32 @addzero(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
@@ -0,0 +1,10 @@
+; Le coppie scritte per Alive2 passano da alive-tv, quando e' installato
+; REQUIRES: alive-tv
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: opt %loadtestpass -passes=testpass-peephole -testpass-alive2-dir=%t -disable-output %S/alive2-dump.ll
+; RUN: opt %loadtestpass -passes=testpass-peephole -testpass-alive2-dir=%t -disable-output %S/strength-reduction-mul-flags.ll
+; RUN: opt %loadtestpass -passes=testpass-peephole -testpass-alive2-dir=%t -disable-output %S/strength-reduction-udiv-cmp.ll
+; RUN: for f in %t/*.ll; do alive-tv $f || exit 1; done > %t.log
+; RUN: FileCheck %s --implicit-check-not="doesn't verify" --implicit-check-not=ERROR < %t.log
+
+; CHECK: Transformation seems to be correct
@@ -0,0 +1,77 @@
+; Le espressioni affini nell'IV con una mul diventano una PHI incrementata al
+; latch; una ricorrenza con lo stesso passo e partenza a distanza costante
+; riusa la PHI con una add. Il passo puo' essere un valore invariante; i*i
+; non e' affine e resta com'e'
+; RUN: opt %loadtestpass -passes='loop(iv-strength-reduction)' -S %s | FileCheck %s
+
+define void @scaled(i32* %p, i64 %n) {
+; CHECK-LABEL: @scaled(
+; CHECK:       loop:
+; CHECK-NEXT:    [[IV:%.*]] = phi i64 [ [[NEXT:%.*]], %loop ], [ 0, %entry ]
+; CHECK-NEXT:    %i = phi i64
+; CHECK-NEXT:    [[OFF:%.*]] = add i64 [[IV]], 5
+; CHECK-NEXT:    %a = getelementptr i32, i32* %p, i64 [[IV]]
+; CHECK:         %b = getelementptr i32, i32* %p, i64 [[OFF]]
+; CHECK-NOT:     mul
+; CHECK:         [[NEXT]] = add i64 [[IV]], 12
+; CHECK-NEXT:    br i1 %c
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %m = mul i64 %i, 12
+  %a = getelementptr i32, i32* %p, i64 %m
+  store i32 0, i32* %a
+  %m2 = mul i64 %i, 12
+  %o = add i64 %m2, 5
+  %b = getelementptr i32, i32* %p, i64 %o
+  store i32 1, i32* %b
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @invariant_step(i32* %p, i64 %n, i64 %s) {
+; CHECK-LABEL: @invariant_step(
+; CHECK:         [[IV:%.*]] = phi i64 [ [[NEXT:%.*]], %loop ], [ 0, %entry ]
+; CHECK:         %a = getelementptr i32, i32* %p, i64 [[IV]]
+; CHECK-NOT:     mul
+; CHECK:         [[NEXT]] = add i64 [[IV]], %s
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %m = mul i64 %i, %s
+  %a = getelementptr i32, i32* %p, i64 %m
+  store i32 0, i32* %a
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @not_affine(i64* %p, i64 %n) {
+; CHECK-LABEL: @not_affine(
+; CHECK-NOT:     phi i64 [ {{.*}}, %loop ], [ 0, %entry ]
+; CHECK:         %sq = mul i64 %i, %i
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %sq = mul i64 %i, %i
+  store i64 %sq, i64* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret void
+}
@@ -0,0 +1,45 @@
+# -*- Python -*-
+
+import os
+import shutil
+import subprocess
+
+import lit.formats
+
+config.name = 'TestPass'
+config.test_format = lit.formats.ShTest(True)
+config.suffixes = ['.ll']
+# Inputs contiene moduli usati dai test, non test
+config.excludes = ['Inputs']
+config.test_source_root = os.path.dirname(__file__)
+config.test_exec_root = config.testpass_obj_root
+
+config.environment['PATH'] = os.path.pathsep.join(
+    [config.llvm_tools_dir, config.environment.get('PATH', '')])
+
+# opt registra le opzioni del plugin solo con -load, i pass con -load-pass-plugin
+config.substitutions.append(('%testpass', config.testpass_plugin))
+config.substitutions.append(
+    ('%loadtestpass', '-load {0} -load-pass-plugin {0}'.format(config.testpass_plugin)))
+
+# REQUIRES: x86-registered-target e simili, come nei test di LLVM
+llc = os.path.join(config.llvm_tools_dir, 'llc')
+targets = subprocess.run([llc, '--version'], stdout=subprocess.PIPE, universal_newlines=True).stdout
+in_targets = False
+for line in targets.splitlines():
+    if 'Registered Targets' in line:
+        in_targets = True
+    elif in_targets and line.strip():
+        name = line.split()[0]
+        if name == 'x86-64':
+            config.available_features.add('x86-registered-target')
+        elif name == 'aarch64':
+            config.available_features.add('aarch64-registered-target')
+        elif name == 'riscv64':
+            config.available_features.add('riscv-registered-target')
+
+# llvm-stress non e' in tutte le installazioni; alive-tv (Alive2) si cerca nel PATH
+if os.path.exists(os.path.join(config.llvm_tools_dir, 'llvm-stress')):
+    config.available_features.add('llvm-stress')
+if shutil.which('alive-tv', path=config.environment['PATH']):
+    config.available_features.add('alive-tv')
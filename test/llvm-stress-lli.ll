@@ -0,0 +1,17 @@
+; Seed fissi di llvm-stress attraverso ogni pass: l'output di lli sul modulo
+; ottimizzato deve coincidere con quello sull'originale. I seed sono scelti
+; tra quelli che terminano e su cui almeno un pass riscrive qualcosa
+; REQUIRES: llvm-stress
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: for s in 2 21 60 140 175 270 283 284; do \
+; RUN:   llvm-stress -seed=$s -size=25 | sed 's/@autogen_SD[0-9]*/@autogen/' > %t/$s.ll && \
+; RUN:   lli -extra-module=%t/$s.ll %S/Inputs/stress-driver.ll > %t/$s.ref || exit 1; \
+; RUN: done
+; RUN: for p in algebraic-identity multi-instruction reassociate-constants strength-reduction \
+; RUN:          testpass-peephole 'testpass-parallel<2>'; do \
+; RUN:   for s in 2 21 60 140 175 270 283 284; do \
+; RUN:     opt %loadtestpass -passes="$p" -S %t/$s.ll -o %t/$s.opt && \
+; RUN:     lli -extra-module=%t/$s.opt %S/Inputs/stress-driver.ll > %t/$s.out && \
+; RUN:     diff %t/$s.ref %t/$s.out || { echo "seed $s, $p"; exit 1; }; \
+; RUN:   done; \
+; RUN: done
@@ -0,0 +1,107 @@
+; Inoltro store/load nelle regole multi-istruzione: con MemorySSA lo store
+; che definisce il load puo' stare in un blocco dominante o prima di store
+; che AA dimostra disgiunti; senza, la ricerca resta nel blocco del load e si
+; ferma al primo store che non e' su un oggetto distinto. Mai oltre una
+; chiamata, uno store che puo' sovrapporsi o un load volatile
+; RUN: opt %loadtestpass -passes=multi-instruction -S %s | FileCheck %s --check-prefixes=CHECK,MSSA
+; RUN: opt %loadtestpass -passes=multi-instruction -testpass-memssa-forwarding=false -S %s | FileCheck %s --check-prefixes=CHECK,BLOCK
+
+define i32 @cross_block(i32* %p, i32 %b, i32 %c, i1 %cond) {
+; CHECK-LABEL: @cross_block(
+; MSSA:         ret i32 %b
+; BLOCK:        [[R:%.*]] = sub i32 %l, %c
+; BLOCK-NEXT:   ret i32 [[R]]
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  br i1 %cond, label %then, label %exit
+then:
+  br label %exit
+exit:
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+define i32 @noalias_between(i32* noalias %p, i32* noalias %q, i32 %b, i32 %c) {
+; CHECK-LABEL: @noalias_between(
+; CHECK:        ret i32 %b
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  store i32 0, i32* %q
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+define i32 @may_alias(i32* %p, i32* %q, i32 %b, i32 %c) {
+; CHECK-LABEL: @may_alias(
+; CHECK:        [[R:%.*]] = sub i32 %l, %c
+; CHECK-NEXT:   ret i32 [[R]]
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  store i32 0, i32* %q
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+define i32 @not_dominating(i32* %p, i32 %b, i32 %c, i1 %cond) {
+; CHECK-LABEL: @not_dominating(
+; CHECK:        [[R:%.*]] = sub i32 %l, %c
+; CHECK-NEXT:   ret i32 [[R]]
+entry:
+  br i1 %cond, label %then, label %exit
+then:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  br label %exit
+exit:
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+define i32 @call_between(i32* %p, i32 %b, i32 %c) {
+; CHECK-LABEL: @call_between(
+; CHECK:        [[R:%.*]] = sub i32 %l, %c
+; CHECK-NEXT:   ret i32 [[R]]
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  call void @clobber()
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+define i32 @volatile_load(i32* %p, i32 %b, i32 %c) {
+; CHECK-LABEL: @volatile_load(
+; CHECK:        [[R:%.*]] = sub i32 %l, %c
+; CHECK-NEXT:   ret i32 [[R]]
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  %l = load volatile i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+declare void @clobber()
+
+define i32 @other_offset(i32* %p, i32 %b, i32 %c) {
+; CHECK-LABEL: @other_offset(
+; MSSA:         ret i32 %b
+; BLOCK:        [[R:%.*]] = sub i32 %l, %c
+; BLOCK-NEXT:   ret i32 [[R]]
+entry:
+  %s = add i32 %b, %c
+  store i32 %s, i32* %p
+  %q = getelementptr i32, i32* %p, i64 1
+  store i32 0, i32* %q
+  %l = load i32, i32* %p
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
@@ -0,0 +1,127 @@
+; Riassociazione: le costanti di una catena di add/sub/mul/and/or/xor con un
+; solo uso si raccolgono in una sola sull'operando 1, i flag restano se
+; tutti i nodi li hanno. Un nodo con piu' usi resta una foglia
+; RUN: opt %loadtestpass -passes=reassociate-constants -S %s | FileCheck %s
+
+define i32 @add_chain(i32 %x, i32 %y) {
+; CHECK-LABEL: @add_chain(
+; CHECK-NEXT:    [[A:%.*]] = add i32 %x, %y
+; CHECK-NEXT:    [[R:%.*]] = add i32 [[A]], 7
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = add i32 %x, 3
+  %b = add i32 %a, %y
+  %c = add i32 %b, 4
+  ret i32 %c
+}
+
+define i32 @mul_chain(i32 %x) {
+; CHECK-LABEL: @mul_chain(
+; CHECK-NEXT:    [[R:%.*]] = mul i32 %x, 15
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = mul i32 3, %x
+  %b = mul i32 %a, 5
+  ret i32 %b
+}
+
+define i32 @sub_const(i32 %x) {
+; CHECK-LABEL: @sub_const(
+; CHECK-NEXT:    [[R:%.*]] = add i32 %x, -7
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = sub i32 %x, 10
+  %b = add i32 %a, 3
+  ret i32 %b
+}
+
+define i32 @cancel(i32 %x) {
+; CHECK-LABEL: @cancel(
+; CHECK-NEXT:    ret i32 %x
+  %a = add i32 %x, 5
+  %b = add i32 %a, -5
+  ret i32 %b
+}
+
+define i32 @xor_chain(i32 %x) {
+; CHECK-LABEL: @xor_chain(
+; CHECK-NEXT:    [[R:%.*]] = xor i32 %x, 6
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = xor i32 %x, 12
+  %b = xor i32 %a, 10
+  ret i32 %b
+}
+
+define i32 @and_or(i32 %x) {
+; CHECK-LABEL: @and_or(
+; CHECK-NEXT:    [[A:%.*]] = and i32 %x, 15
+; CHECK-NEXT:    [[R:%.*]] = or i32 [[A]], 3
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = and i32 %x, 255
+  %b = and i32 %a, 15
+  %c = or i32 %b, 1
+  %d = or i32 %c, 2
+  ret i32 %d
+}
+
+define i32 @swap(i32 %x) {
+; CHECK-LABEL: @swap(
+; CHECK-NEXT:    %a = add i32 %x, 7
+; CHECK-NEXT:    ret i32 %a
+  %a = add i32 7, %x
+  ret i32 %a
+}
+
+define i32 @flags(i32 %x) {
+; CHECK-LABEL: @flags(
+; CHECK-NEXT:    [[R:%.*]] = add nuw nsw i32 %x, 7
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = add nuw nsw i32 %x, 3
+  %b = add nuw nsw i32 %a, 4
+  ret i32 %b
+}
+
+define i32 @multi_use(i32 %x) {
+; CHECK-LABEL: @multi_use(
+; CHECK-NEXT:    %a = add i32 %x, 3
+; CHECK-NEXT:    %b = add i32 %a, 4
+; CHECK-NEXT:    %r = mul i32 %a, %b
+  %a = add i32 %x, 3
+  %b = add i32 %a, 4
+  %r = mul i32 %a, %b
+  ret i32 %r
+}
+
+define <2 x i32> @vec(<2 x i32> %x) {
+; CHECK-LABEL: @vec(
+; CHECK-NEXT:    [[R:%.*]] = add <2 x i32> %x, <i32 4, i32 6>
+; CHECK-NEXT:    ret <2 x i32> [[R]]
+  %a = add <2 x i32> %x, <i32 1, i32 2>
+  %b = add <2 x i32> %a, <i32 3, i32 4>
+  ret <2 x i32> %b
+}
+
+; Piu' nodi del limite di foglie: l'albero si riduce a pezzi, fino in fondo
+define i32 @long(i32 %x0) {
+; CHECK-LABEL: @long(
+; CHECK-NEXT:    [[R:%.*]] = add i32 %x0, 20
+; CHECK-NEXT:    ret i32 [[R]]
+  %x1 = add i32 %x0, 1
+  %x2 = add i32 %x1, 1
+  %x3 = add i32 %x2, 1
+  %x4 = add i32 %x3, 1
+  %x5 = add i32 %x4, 1
+  %x6 = add i32 %x5, 1
+  %x7 = add i32 %x6, 1
+  %x8 = add i32 %x7, 1
+  %x9 = add i32 %x8, 1
+  %x10 = add i32 %x9, 1
+  %x11 = add i32 %x10, 1
+  %x12 = add i32 %x11, 1
+  %x13 = add i32 %x12, 1
+  %x14 = add i32 %x13, 1
+  %x15 = add i32 %x14, 1
+  %x16 = add i32 %x15, 1
+  %x17 = add i32 %x16, 1
+  %x18 = add i32 %x17, 1
+  %x19 = add i32 %x18, 1
+  %x20 = add i32 %x19, 1
+  ret i32 %x20
+}
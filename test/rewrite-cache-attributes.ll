@@ -0,0 +1,31 @@
+; Gli attributi dei parametri e i metadati per l'alias analysis fanno parte
+; della chiave della cache: con noalias o tbaa lo store in %q non copre piu'
+; quello in %p, e la funzione registrata come invariata va riscritta
+; RUN: rm -f %t.cache
+; RUN: opt %loadtestpass -passes=multi-instruction -testpass-cache-file=%t.cache -S %s | FileCheck %s --check-prefix=MAYALIAS
+; RUN: sed -e 's/(i32\* /(i32* noalias /' %s \
+; RUN:   | opt %loadtestpass -passes=multi-instruction -testpass-cache-file=%t.cache -S | FileCheck %s --check-prefix=FORWARD
+; RUN: sed -e 's/, !tbaa-placeholder !\([0-9]\)/, !tbaa !\1/' %s \
+; RUN:   | opt %loadtestpass -passes=multi-instruction -testpass-cache-file=%t.cache -S | FileCheck %s --check-prefix=FORWARD
+
+define i32 @f(i32* %p, float* %q, i32 %b, i32 %c) {
+; MAYALIAS-LABEL: @f(
+; MAYALIAS:         [[R:%.*]] = sub i32 %l, %c
+; MAYALIAS-NEXT:    ret i32 [[R]]
+;
+; FORWARD-LABEL: @f(
+; FORWARD:          ret i32 %b
+;
+  %a = add i32 %b, %c
+  store i32 %a, i32* %p, !tbaa-placeholder !1
+  store float 0.0, float* %q, !tbaa-placeholder !2
+  %l = load i32, i32* %p, !tbaa-placeholder !1
+  %r = sub i32 %l, %c
+  ret i32 %r
+}
+
+!0 = !{!"tbaa root"}
+!1 = !{!3, !3, i64 0}
+!2 = !{!4, !4, i64 0}
+!3 = !{!"int", !0, i64 0}
+!4 = !{!"float", !0, i64 0}
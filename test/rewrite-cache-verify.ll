@@ -0,0 +1,17 @@
+; In modalita' verifica (e con il dump per Alive2) la cache non si usa: una
+; funzione registrata come invariata verrebbe saltata senza controllarne le
+; riscritture, e un rifiuto della verifica non deve finire nella cache
+; RUN: rm -f %t.cache %t.verify
+; RUN: opt %loadtestpass -passes=strength-reduction -testpass-verify-rewrites -testpass-cache-file=%t.verify -disable-output %s
+; RUN: not test -e %t.verify
+; RUN: opt %loadtestpass -passes=strength-reduction -testpass-alive2-dir=%t.dir -testpass-cache-file=%t.verify -disable-output %s
+; RUN: not test -e %t.verify
+; RUN: opt %loadtestpass -passes=strength-reduction -testpass-cache-file=%t.cache -disable-output %s
+; RUN: FileCheck %s < %t.cache
+
+; CHECK: testpass-cache
+
+define i32 @f(i32 %x) {
+  %m = mul i32 %x, 1717986919
+  ret i32 %m
+}
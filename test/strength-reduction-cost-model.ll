@@ -0,0 +1,97 @@
+; Scelta del modello di costo: il parametro cost= del pass vince su
+; -testpass-cost-kind, che vince sugli attributi; minsize e i blocchi freddi
+; secondo il profilo usano la dimensione del codice, optsize dimensione e
+; latenza. Su AArch64 lo shift nell'operando della add e' gratis, e x * 11
+; conviene espansa anche dove su x86-64 resta una mul
+; REQUIRES: x86-registered-target, aarch64-registered-target
+; RUN: opt %loadtestpass -passes='require<profile-summary>,function(strength-reduction)' -S %s | FileCheck %s --check-prefixes=CHECK,DEFAULT
+; RUN: opt %loadtestpass -passes='require<profile-summary>,function(strength-reduction)' -testpass-cost-kind=latency -S %s | FileCheck %s --check-prefixes=CHECK,LATENCY
+; RUN: opt %loadtestpass -passes='require<profile-summary>,function(strength-reduction)' -testpass-cost-kind=code-size -S %s | FileCheck %s --check-prefixes=CHECK,SIZE
+; RUN: opt %loadtestpass -passes='require<profile-summary>,function(strength-reduction<cost=latency>)' -testpass-cost-kind=code-size -S %s | FileCheck %s --check-prefixes=CHECK,LATENCY
+; RUN: sed 's/x86_64/aarch64/' %s | opt %loadtestpass -passes=strength-reduction -S | FileCheck %s --check-prefixes=CHECK,A64
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @plain(i32 %x) {
+; CHECK-LABEL: @plain(
+; DEFAULT-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; DEFAULT-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; DEFAULT-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; LATENCY-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; LATENCY-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; LATENCY-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; SIZE-NEXT:    %m = mul i32 %x, 6
+  %m = mul i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @minsize(i32 %x) minsize {
+; CHECK-LABEL: @minsize(
+; DEFAULT-NEXT:    %m = mul i32 %x, 6
+; LATENCY-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; LATENCY-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; LATENCY-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; SIZE-NEXT:    %m = mul i32 %x, 6
+  %m = mul i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @optsize(i32 %x) optsize {
+; CHECK-LABEL: @optsize(
+; DEFAULT-NEXT:    %m = mul i32 %x, 6
+; LATENCY-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; LATENCY-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; LATENCY-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; SIZE-NEXT:    %m = mul i32 %x, 6
+  %m = mul i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @mul11(i32 %x) {
+; CHECK-LABEL: @mul11(
+; DEFAULT-NEXT:  %m = mul i32 %x, 11
+; A64-NEXT:      [[A:%.*]] = shl i32 %x, 2
+; A64-NEXT:      [[B:%.*]] = shl i32 %x, 4
+; A64-NEXT:      [[C:%.*]] = add i32 %x, [[A]]
+; A64-NEXT:      [[R:%.*]] = sub i32 [[B]], [[C]]
+  %m = mul i32 %x, 11
+  ret i32 %m
+}
+
+define i32 @cold_block(i32 %x, i1 %c) !prof !14 {
+; CHECK-LABEL: @cold_block(
+; CHECK:         cold:
+; DEFAULT-NEXT:    %m = mul i32 %x, 6
+; LATENCY-NEXT:    shl i32 %x, 1
+; SIZE-NEXT:       %m = mul i32 %x, 6
+; CHECK:         hot:
+; DEFAULT-NEXT:    shl i32 %x, 1
+; LATENCY-NEXT:    shl i32 %x, 1
+; SIZE-NEXT:       %h = mul i32 %x, 6
+entry:
+  br i1 %c, label %cold, label %hot, !prof !15
+cold:
+  %m = mul i32 %x, 6
+  ret i32 %m
+hot:
+  %h = mul i32 %x, 6
+  ret i32 %h
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 1, !"ProfileSummary", !1}
+!1 = !{!2, !3, !4, !5, !6, !7, !8, !9}
+!2 = !{!"ProfileFormat", !"InstrProf"}
+!3 = !{!"TotalCount", i64 10000}
+!4 = !{!"MaxCount", i64 10}
+!5 = !{!"MaxInternalCount", i64 1}
+!6 = !{!"MaxFunctionCount", i64 1000}
+!7 = !{!"NumCounts", i64 3}
+!8 = !{!"NumFunctions", i64 3}
+!9 = !{!"DetailedSummary", !10}
+!10 = !{!11, !12, !13}
+!11 = !{i32 10000, i64 100, i32 1}
+!12 = !{i32 999000, i64 100, i32 1}
+!13 = !{i32 999999, i64 1, i32 2}
+!14 = !{!"function_entry_count", i64 1000}
+!15 = !{!"branch_weights", i32 1, i32 100000}
@@ -0,0 +1,27 @@
+; In latenza TTI non distingue le operazioni: la sequenza della divisione si
+; confronta con le latenze di riferimento del target. Su RISC-V senza M mul e
+; div sono chiamate di libreria, quindi il quoziente per 7 (una mulh) conviene
+; ma il resto (mulh, mul e sub) costa piu' della urem
+; REQUIRES: riscv-registered-target
+; RUN: opt %loadtestpass -passes='strength-reduction' -pass-remarks-missed=testpass -S %s 2>%t.remarks | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+
+; REMARK:     remark: {{.*}} urem by 7 not lowered: expansion slower than the division
+; REMARK-NOT: remark: {{.*}} udiv
+
+target triple = "riscv64-unknown-linux-gnu"
+
+define i32 @udiv_by_7(i32 %x) {
+; CHECK-LABEL: @udiv_by_7(
+; CHECK-NOT:     udiv
+; CHECK:         ret i32
+  %q = udiv i32 %x, 7
+  ret i32 %q
+}
+
+define i32 @urem_by_7(i32 %x) {
+; CHECK-LABEL: @urem_by_7(
+; CHECK:         urem i32 %x, 7
+  %r = urem i32 %x, 7
+  ret i32 %r
+}
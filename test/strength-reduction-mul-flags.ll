@@ -0,0 +1,43 @@
+; Con nuw/nsw sulla mul, a parita' di costo si sceglie una catena di sole shl
+; e add, su cui i flag restano validi; senza flag resta la NAF con la sub. Se
+; la catena senza sub costa di piu' (x * 7) si tiene la sub e si perdono i flag
+; RUN: opt %loadtestpass -passes='strength-reduction' -S %s | FileCheck %s
+
+define i32 @mul6_flags(i32 %x) {
+; CHECK-LABEL: @mul6_flags(
+; CHECK-NEXT:    [[A:%.*]] = shl nuw nsw i32 %x, 1
+; CHECK-NEXT:    [[B:%.*]] = shl nuw nsw i32 %x, 2
+; CHECK-NEXT:    [[R:%.*]] = add nuw nsw i32 [[A]], [[B]]
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul nuw nsw i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @mul6(i32 %x) {
+; CHECK-LABEL: @mul6(
+; CHECK-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; CHECK-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; CHECK-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @mul24_nuw(i32 %x) {
+; CHECK-LABEL: @mul24_nuw(
+; CHECK-NEXT:    [[A:%.*]] = shl nuw i32 %x, 3
+; CHECK-NEXT:    [[B:%.*]] = shl nuw i32 %x, 4
+; CHECK-NEXT:    [[R:%.*]] = add nuw i32 [[A]], [[B]]
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul nuw i32 %x, 24
+  ret i32 %m
+}
+
+define i32 @mul7_nsw(i32 %x) {
+; CHECK-LABEL: @mul7_nsw(
+; CHECK-NEXT:    [[A:%.*]] = shl i32 %x, 3
+; CHECK-NEXT:    [[R:%.*]] = sub i32 [[A]], %x
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul nsw i32 %x, 7
+  ret i32 %m
+}
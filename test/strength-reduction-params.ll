@@ -0,0 +1,60 @@
+; Parametri di strength-reduction<...>: famiglie di regole abilitate,
+; lunghezza massima della catena, tipo di costo, vettori. Un parametro non
+; valido fa fallire il parsing della pipeline con un messaggio del plugin
+; REQUIRES: x86-registered-target
+; RUN: opt %loadtestpass -passes='strength-reduction' -S %s | FileCheck %s --check-prefixes=MUL,DIV,VEC
+; RUN: opt %loadtestpass -passes='strength-reduction<max-chain=3;cost=latency>' -S %s | FileCheck %s --check-prefixes=MUL,DIV,VEC
+; RUN: opt %loadtestpass -passes='strength-reduction<no-mul>' -S %s | FileCheck %s --check-prefixes=KEEPMUL,DIV,KEEPVEC
+; RUN: opt %loadtestpass -passes='strength-reduction<no-div;no-vector>' -S %s | FileCheck %s --check-prefixes=MUL,KEEPDIV,KEEPVEC
+; RUN: opt %loadtestpass -passes='strength-reduction<max-chain=2>' -S %s | FileCheck %s --check-prefixes=KEEPMUL,DIV,VEC
+; RUN: opt %loadtestpass -passes='strength-reduction<cost=code-size>' -S %s | FileCheck %s --check-prefixes=KEEPMUL,DIV,VEC
+; RUN: not opt %loadtestpass -passes='strength-reduction<foo>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR-PARAM
+; RUN: not opt %loadtestpass -passes='strength-reduction<no-max-chain=2>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR-NO
+; RUN: not opt %loadtestpass -passes='strength-reduction<max-chain=abc>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR-CHAIN
+; RUN: not opt %loadtestpass -passes='strength-reduction<cost=fast>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR-COST
+; RUN: not opt %loadtestpass -passes='strength-reduction<mul' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR-SYNTAX
+
+; ERR-PARAM: testpass: invalid strength-reduction parameter 'foo'
+; ERR-NO: testpass: invalid strength-reduction parameter 'max-chain=2'
+; ERR-CHAIN: testpass: invalid strength-reduction max-chain 'abc'
+; ERR-COST: testpass: invalid strength-reduction cost 'fast'
+; ERR-SYNTAX-NOT: testpass:
+; ERR-SYNTAX: unknown pass name 'strength-reduction<mul'
+
+target triple = "x86_64-unknown-linux-gnu"
+
+; x * 6 = (x << 3) - (x << 1): tre passi, piu' di una mul per code-size
+define i32 @mul6(i32 %x) {
+; MUL-LABEL: @mul6(
+; MUL-NEXT:    [[A:%.*]] = shl i32 %x, 1
+; MUL-NEXT:    [[B:%.*]] = shl i32 %x, 3
+; MUL-NEXT:    [[R:%.*]] = sub i32 [[B]], [[A]]
+; MUL-NEXT:    ret i32 [[R]]
+; KEEPMUL-LABEL: @mul6(
+; KEEPMUL-NEXT:    [[R:%.*]] = mul i32 %x, 6
+; KEEPMUL-NEXT:    ret i32 [[R]]
+  %m = mul i32 %x, 6
+  ret i32 %m
+}
+
+define i32 @udiv4(i32 %x) {
+; DIV-LABEL: @udiv4(
+; DIV-NEXT:    [[R:%.*]] = lshr i32 %x, 2
+; DIV-NEXT:    ret i32 [[R]]
+; KEEPDIV-LABEL: @udiv4(
+; KEEPDIV-NEXT:    [[R:%.*]] = udiv i32 %x, 4
+; KEEPDIV-NEXT:    ret i32 [[R]]
+  %d = udiv i32 %x, 4
+  ret i32 %d
+}
+
+define <4 x i32> @vmul8(<4 x i32> %x) {
+; VEC-LABEL: @vmul8(
+; VEC-NEXT:    [[R:%.*]] = shl <4 x i32> %x, <i32 3, i32 3, i32 3, i32 3>
+; VEC-NEXT:    ret <4 x i32> [[R]]
+; KEEPVEC-LABEL: @vmul8(
+; KEEPVEC-NEXT:    [[R:%.*]] = mul <4 x i32> %x, <i32 8, i32 8, i32 8, i32 8>
+; KEEPVEC-NEXT:    ret <4 x i32> [[R]]
+  %m = mul <4 x i32> %x, <i32 8, i32 8, i32 8, i32 8>
+  ret <4 x i32> %m
+}
@@ -0,0 +1,17 @@
+; Le remark "missed" riguardano solo le istruzioni originali: le mul create
+; dall'espansione delle divisioni (mulh per 3435973837, -1840700269) non ne
+; producono
+; RUN: opt %loadtestpass -passes='strength-reduction' -pass-remarks-missed=testpass -disable-output %s 2>&1 | FileCheck %s
+
+; CHECK-NOT:   remark: {{.*}} mul by 3435973837
+; CHECK-NOT:   remark: {{.*}} mul by -1840700269
+; CHECK:       remark: {{.*}} mul by 1717986919 not lowered
+; CHECK-NOT:   remark:
+
+define i32 @f(i32 %x) {
+  %q = udiv i32 %x, 10
+  %r = sdiv i32 %x, 7
+  %s = add i32 %q, %r
+  %m = mul i32 %s, 1717986919
+  ret i32 %m
+}
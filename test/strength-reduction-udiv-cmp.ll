@@ -0,0 +1,24 @@
+; Con la famiglia udiv-cmp il confronto di un quoziente diventa un confronto
+; del dividendo; senza, la udiv viene comunque espansa dalla famiglia div
+; RUN: opt %loadtestpass -passes='strength-reduction' -S %s | FileCheck %s --check-prefix=CMP
+; RUN: opt %loadtestpass -passes='strength-reduction<no-udiv-cmp>' -S %s | FileCheck %s --check-prefix=NOCMP
+; RUN: opt %loadtestpass -passes='strength-reduction<no-udiv-cmp;no-div>' -S %s | FileCheck %s --check-prefix=NONE
+
+define i1 @quotient_ult(i32 %x) {
+; CMP-LABEL: @quotient_ult(
+; CMP-NEXT:    [[CMP:%.*]] = icmp ult i32 %x, 40
+; CMP-NEXT:    ret i1 [[CMP]]
+;
+; NOCMP-LABEL: @quotient_ult(
+; NOCMP-NOT:     udiv
+; NOCMP:         lshr
+; NOCMP:         icmp ult i32 {{%.*}}, 4
+;
+; NONE-LABEL: @quotient_ult(
+; NONE-NEXT:     [[Q:%.*]] = udiv i32 %x, 10
+; NONE-NEXT:     [[C:%.*]] = icmp ult i32 [[Q]], 4
+;
+  %q = udiv i32 %x, 10
+  %c = icmp ult i32 %q, 4
+  ret i1 %c
+}
@@ -0,0 +1,46 @@
+; Mul per costanti diverse per lane: con shift variabili nativi (AVX2) diventa
+; shift per lane piu' add, con SSE2 resta una mul perche' il backend
+; espanderebbe gli shift. Una lane con shift 0 in tutte le posizioni usa x
+; REQUIRES: x86-registered-target
+; RUN: opt %loadtestpass -passes='strength-reduction' -S %s | FileCheck %s --check-prefix=SSE2
+; RUN: opt %loadtestpass -passes='strength-reduction' -mattr=+avx2 -S %s | FileCheck %s --check-prefix=AVX2
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define <4 x i32> @mul_lanes(<4 x i32> %x) {
+; SSE2-LABEL: @mul_lanes(
+; SSE2-NEXT:    [[M:%.*]] = mul <4 x i32> %x, <i32 3, i32 5, i32 9, i32 17>
+; SSE2-NEXT:    ret <4 x i32> [[M]]
+;
+; AVX2-LABEL: @mul_lanes(
+; AVX2-NEXT:    [[SHIFT:%.*]] = shl <4 x i32> %x, <i32 1, i32 2, i32 3, i32 4>
+; AVX2-NEXT:    [[ADD:%.*]] = add <4 x i32> [[SHIFT]], %x
+; AVX2-NEXT:    ret <4 x i32> [[ADD]]
+;
+  %m = mul <4 x i32> %x, <i32 3, i32 5, i32 9, i32 17>
+  ret <4 x i32> %m
+}
+
+define <4 x i32> @mul_lanes_pow2(<4 x i32> %x) {
+; SSE2-LABEL: @mul_lanes_pow2(
+; SSE2-NEXT:    [[M:%.*]] = mul <4 x i32> %x, <i32 2, i32 4, i32 8, i32 16>
+;
+; AVX2-LABEL: @mul_lanes_pow2(
+; AVX2-NEXT:    [[SHIFT:%.*]] = shl <4 x i32> %x, <i32 1, i32 2, i32 3, i32 4>
+; AVX2-NEXT:    ret <4 x i32> [[SHIFT]]
+;
+  %m = mul <4 x i32> %x, <i32 2, i32 4, i32 8, i32 16>
+  ret <4 x i32> %m
+}
+
+; Nessun shl per zeroinitializer
+define <4 x i32> @mul_lanes_sub(<4 x i32> %x) {
+; AVX2-LABEL: @mul_lanes_sub(
+; AVX2-NOT:     zeroinitializer
+; AVX2:         [[SHIFT:%.*]] = shl <4 x i32> %x, <i32 1, i32 2, i32 3, i32 4>
+; AVX2-NEXT:    [[SUB:%.*]] = sub <4 x i32> [[SHIFT]], %x
+; AVX2-NEXT:    ret <4 x i32> [[SUB]]
+;
+  %m = mul <4 x i32> %x, <i32 1, i32 3, i32 7, i32 15>
+  ret <4 x i32> %m
+}
@@ -0,0 +1,64 @@
+; testpass-parallel<N> applica le regole del pass combinato alle funzioni del
+; modulo su N thread: il risultato non dipende dal numero di thread ed e'
+; quello del pass seriale
+; RUN: opt %loadtestpass -passes=testpass-peephole -S %s > %t.serial
+; RUN: opt %loadtestpass -passes='testpass-parallel<1>' -S %s > %t.p1
+; RUN: opt %loadtestpass -passes='testpass-parallel<4>' -S %s > %t.p4
+; RUN: opt %loadtestpass -passes=testpass-parallel -S %s > %t.pdef
+; RUN: diff %t.serial %t.p1
+; RUN: diff %t.serial %t.p4
+; RUN: diff %t.serial %t.pdef
+; RUN: FileCheck %s < %t.p4
+; RUN: not opt %loadtestpass -passes='testpass-parallel<x>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ERR
+
+; ERR: unknown pass name 'testpass-parallel<x>'
+
+define i32 @mul9(i32 %x) {
+; CHECK-LABEL: @mul9(
+; CHECK-NEXT:    [[S:%.*]] = shl i32 %x, 3
+; CHECK-NEXT:    [[R:%.*]] = add i32 %x, [[S]]
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul i32 %x, 9
+  ret i32 %m
+}
+
+define i32 @udiv16(i32 %x) {
+; CHECK-LABEL: @udiv16(
+; CHECK-NEXT:    [[R:%.*]] = lshr i32 %x, 4
+; CHECK-NEXT:    ret i32 [[R]]
+  %d = udiv i32 %x, 16
+  ret i32 %d
+}
+
+define i32 @identity(i32 %x) {
+; CHECK-LABEL: @identity(
+; CHECK-NEXT:    ret i32 %x
+  %a = add i32 %x, 0
+  %b = mul i32 %a, 1
+  ret i32 %b
+}
+
+define i32 @consts(i32 %x) {
+; CHECK-LABEL: @consts(
+; CHECK-NEXT:    [[R:%.*]] = add i32 %x, 7
+; CHECK-NEXT:    ret i32 [[R]]
+  %a = add i32 %x, 3
+  %b = add i32 %a, 4
+  ret i32 %b
+}
+
+define i32 @cancel(i32 %x, i32 %y) {
+; CHECK-LABEL: @cancel(
+; CHECK-NEXT:    ret i32 %x
+  %a = add i32 %x, %y
+  %b = sub i32 %a, %y
+  ret i32 %b
+}
+
+define i32 @untouched(i32 %x, i32 %y) {
+; CHECK-LABEL: @untouched(
+; CHECK-NEXT:    [[R:%.*]] = mul i32 %x, %y
+; CHECK-NEXT:    ret i32 [[R]]
+  %m = mul i32 %x, %y
+  ret i32 %m
+}